@@ -0,0 +1,193 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : accel_calibration.c
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Six-position static calibration of the accelerometer.
+ *                The sensor is modelled as raw = M * g + b. With the board
+ *                resting with each axis pointing up and then down:
+ *                    M column i = (raw(+i) - raw(-i)) / 2
+ *                    b          = mean of (raw(+i) + raw(-i)) / 2
+ *                The stored transform is gain = M^-1, offset = -M^-1 * b,
+ *                which also absorbs any rotation from the mounting.
+ ******************************************************************************/
+
+#include <app.h>
+#include "data_flash.h"
+#include "accel_calibration.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#define CALIBRATION_MAGIC 0x4d314341
+
+typedef struct accel_calibration_record
+{
+    uint32_t            magic;
+    accel_transform_t   transform;
+    uint32_t            checksum;
+} accel_calibration_record_t;
+
+static float captures[CALIBRATION_ORIENTATIONS][3];
+static uint8_t captured = 0;
+
+/******************************************************************************
+* Function Name: record_checksum
+* Description  : Simple additive checksum over the record, excluding the
+*                checksum word itself.
+* Arguments    : p_record –
+*                    record to check.
+* Return Value : The checksum.
+******************************************************************************/
+static uint32_t record_checksum(const accel_calibration_record_t * p_record) {
+    const uint32_t * p_word = (const uint32_t *)p_record;
+    uint32_t sum = 0;
+
+    for (unsigned int i = 0; i < offsetof(accel_calibration_record_t, checksum) / sizeof(uint32_t); i++)
+        sum += p_word[i];
+    return ~sum;
+}
+
+/******************************************************************************
+* Function Name: accel_calibration_default
+* Description  : Fills in the uncalibrated transform, which is only the
+*                nominal raw-to-g scale of the sensor.
+* Arguments    : p_transform –
+*                    transform to fill in.
+******************************************************************************/
+void accel_calibration_default(accel_transform_t * p_transform) {
+    memset(p_transform, 0, sizeof(*p_transform));
+    p_transform->gain[0] = ACCEL_RAW_SCALE;
+    p_transform->gain[4] = ACCEL_RAW_SCALE;
+    p_transform->gain[8] = ACCEL_RAW_SCALE;
+}
+
+/******************************************************************************
+* Function Name: accel_calibration_load
+* Description  : Loads the calibration from data-flash, falling back to the
+*                default transform if no valid record is stored.
+* Arguments    : p_transform –
+*                    receives the transform.
+******************************************************************************/
+void accel_calibration_load(accel_transform_t * p_transform) {
+    accel_calibration_record_t record;
+
+    if (data_flash_read(DATA_FLASH_CALIBRATION_ADDRESS, &record, sizeof(record)) == SSP_SUCCESS &&
+            record.magic == CALIBRATION_MAGIC && record.checksum == record_checksum(&record))
+        *p_transform = record.transform;
+    else
+        accel_calibration_default(p_transform);
+}
+
+/******************************************************************************
+* Function Name: accel_calibration_capture
+* Description  : Stores the average raw reading for one orientation.
+* Arguments    : orientation –
+*                    one of CALIBRATION_X_UP .. CALIBRATION_Z_DOWN.
+*                x_raw, y_raw, z_raw -
+*                    average raw counts while resting in that orientation.
+******************************************************************************/
+void accel_calibration_capture(int orientation, float x_raw, float y_raw, float z_raw) {
+    if (orientation < 0 || orientation >= CALIBRATION_ORIENTATIONS)
+        return;
+    captures[orientation][0] = x_raw;
+    captures[orientation][1] = y_raw;
+    captures[orientation][2] = z_raw;
+    captured |= (uint8_t)(1 << orientation);
+}
+
+/******************************************************************************
+* Function Name: accel_calibration_solve
+* Description  : Computes the transform from the six captured orientations.
+* Arguments    : p_transform –
+*                    receives the transform. Untouched on failure.
+* Return Value : true on success, false if an orientation is missing or the
+*                captures are degenerate.
+******************************************************************************/
+bool accel_calibration_solve(accel_transform_t * p_transform) {
+    float m[9];
+    float b[3] = {0, 0, 0};
+    float inv[9];
+
+    if (captured != (1 << CALIBRATION_ORIENTATIONS) - 1)
+        return false;
+
+    for (int i = 0; i < 3; i++) {
+        for (int row = 0; row < 3; row++) {
+            m[row * 3 + i] = (captures[i * 2][row] - captures[i * 2 + 1][row]) / 2;
+            b[row] += (captures[i * 2][row] + captures[i * 2 + 1][row]) / 6;
+        }
+    }
+
+    inv[0] = m[4] * m[8] - m[5] * m[7];
+    inv[1] = m[2] * m[7] - m[1] * m[8];
+    inv[2] = m[1] * m[5] - m[2] * m[4];
+    inv[3] = m[5] * m[6] - m[3] * m[8];
+    inv[4] = m[0] * m[8] - m[2] * m[6];
+    inv[5] = m[2] * m[3] - m[0] * m[5];
+    inv[6] = m[3] * m[7] - m[4] * m[6];
+    inv[7] = m[1] * m[6] - m[0] * m[7];
+    inv[8] = m[0] * m[4] - m[1] * m[3];
+    float det = m[0] * inv[0] + m[1] * inv[3] + m[2] * inv[6];
+    // 1 g should read hundreds of counts on every axis
+    if (det < 1000 && det > -1000)
+        return false;
+
+    for (int i = 0; i < 9; i++)
+        p_transform->gain[i] = inv[i] / det;
+    for (int row = 0; row < 3; row++)
+        p_transform->offset[row] = -(p_transform->gain[row * 3] * b[0] +
+                                     p_transform->gain[row * 3 + 1] * b[1] +
+                                     p_transform->gain[row * 3 + 2] * b[2]);
+    captured = 0;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: accel_calibration_save
+* Description  : Stores the transform in data-flash.
+* Arguments    : p_transform –
+*                    transform to store.
+* Return Value : true on success.
+******************************************************************************/
+bool accel_calibration_save(const accel_transform_t * p_transform) {
+    accel_calibration_record_t record;
+
+    record.magic = CALIBRATION_MAGIC;
+    record.transform = *p_transform;
+    record.checksum = record_checksum(&record);
+    return data_flash_write(DATA_FLASH_CALIBRATION_ADDRESS, &record, sizeof(record)) == SSP_SUCCESS;
+}
+
+/******************************************************************************
+* Function Name: accel_calibration_erase
+* Description  : Removes the stored calibration, so the default transform is
+*                used from the next load.
+* Return Value : true on success.
+******************************************************************************/
+bool accel_calibration_erase(void) {
+    accel_calibration_record_t record;
+
+    memset(&record, 0xff, sizeof(record));
+    captured = 0;
+    return data_flash_write(DATA_FLASH_CALIBRATION_ADDRESS, &record, sizeof(record)) == SSP_SUCCESS;
+}
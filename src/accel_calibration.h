@@ -0,0 +1,75 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : accel_calibration.h
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Accelerometer calibration. Holds the affine transform which
+ *                converts raw accelerometer counts to g in a single step:
+ *                    g = gain * raw + offset
+ *                The raw-to-g scale of the sensor is folded into gain.
+ ******************************************************************************/
+
+#ifndef ACCEL_CALIBRATION_H_
+#define ACCEL_CALIBRATION_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef BMC150
+#define ACCEL_RAW_SCALE 0.00098f
+#else
+#define ACCEL_RAW_SCALE 0.004f
+#endif
+
+// orientations captured by the static calibration procedure
+enum {
+    CALIBRATION_X_UP = 0,
+    CALIBRATION_X_DOWN,
+    CALIBRATION_Y_UP,
+    CALIBRATION_Y_DOWN,
+    CALIBRATION_Z_UP,
+    CALIBRATION_Z_DOWN,
+    CALIBRATION_ORIENTATIONS,
+};
+
+// values of calibration_request besides the orientations
+#define CALIBRATION_REQUEST_NONE    (-2)
+#define CALIBRATION_REQUEST_RESET   (-1)
+#define CALIBRATION_REQUEST_SOLVE   CALIBRATION_ORIENTATIONS
+
+// samples averaged for each orientation
+#define CALIBRATION_SAMPLES 200
+
+typedef struct accel_transform
+{
+    float gain[9];      ///< row-major 3x3 matrix, g per raw count.
+    float offset[3];    ///< g.
+} accel_transform_t;
+
+void accel_calibration_load(accel_transform_t * p_transform);
+void accel_calibration_default(accel_transform_t * p_transform);
+void accel_calibration_capture(int orientation, float x_raw, float y_raw, float z_raw);
+bool accel_calibration_solve(accel_transform_t * p_transform);
+bool accel_calibration_save(const accel_transform_t * p_transform);
+bool accel_calibration_erase(void);
+
+#endif /* ACCEL_CALIBRATION_H_ */
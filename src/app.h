@@ -29,13 +29,22 @@ char fatalErrString[41];
 #define I2C_OPEN
 //#define I2C_LOCKING
 #define I2C_RESTART
-//#define I2C_MULTI_THREAD
+#define I2C_MULTI_THREAD
 //#define I2C_DEBUG
 #define I2C_DEBUG2
 
 
 #define BMC150
+// BMM150 magnetometer on g_sf_spi_device1, chip select P07_12 still to be
+// confirmed against the board schematic. The pin is left unconfigured in
+// the pin configuration until then; set it up as an output, initially high
+// (inactive), before enabling this.
+//#define BMC150_MAG
+// accelerometer on I2C instead of SPI
 //#define I2C_VIBRATION
+// with I2C_VIBRATION, the accelerometer shares the cloud driver bus and
+// bus_schedule keeps cloud transactions out of its sample slots
+#define USE_SHARED_BUS
 
 //#define ENABLE_USB
 
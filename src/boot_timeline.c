@@ -0,0 +1,130 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : boot_timeline.c
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Records the time at which each boot milestone is first
+ *                reached, and how many failed attempts preceded it. Times
+ *                come from timestamp_us, like the command latency, so they
+ *                count from the start of the kernel, to the millisecond.
+ *                When the first telemetry is queued the timeline is
+ *                published once as
+ *                    {"boot_timeline":{"lcd_start_ms":<n>,...}}
+ *                with <name>_retries for milestones that needed retries.
+ *                Milestones not reached are left out. M1_DEBUG builds also
+ *                show the timeline on the LCD.
+ ******************************************************************************/
+
+#include <app.h>
+#include "tx_api.h"
+#include "boot_timeline.h"
+#include "event_batch.h"
+#include "json_writer.h"
+#include "timestamp.h"
+
+#include <stdio.h>
+
+typedef struct boot_milestone_info
+{
+    uint32_t    us;
+    uint16_t    retries;
+    bool        reached;
+} boot_milestone_info_t;
+
+static const char * const milestone_names[BOOT_MILESTONE_COUNT] =
+{
+    [BOOT_LCD_START]        = "lcd_start",
+    [BOOT_LCD_READY]        = "lcd_ready",
+    [BOOT_PROVISION_DONE]   = "provision",
+    [BOOT_LINK_UP]          = "link",
+    [BOOT_DHCP_DONE]        = "dhcp",
+    [BOOT_DNS_DONE]         = "dns",
+    [BOOT_MQTT_CONNECTED]   = "mqtt",
+    [BOOT_FIRST_TELEMETRY]  = "telemetry",
+};
+
+static boot_milestone_info_t milestones[BOOT_MILESTONE_COUNT];
+
+/******************************************************************************
+* Function Name: boot_timeline_publish
+* Description  : Queues the boot_timeline event.
+******************************************************************************/
+static void boot_timeline_publish(void) {
+    char eventbuf[400];
+    char key[24];
+    json_writer_t writer;
+
+    json_begin(&writer, eventbuf, sizeof(eventbuf));
+    json_key_object(&writer, "boot_timeline");
+    for (int i = 0; i < BOOT_MILESTONE_COUNT; i++) {
+        if (!milestones[i].reached)
+            continue;
+        snprintf(key, sizeof(key), "%s_ms", milestone_names[i]);
+        json_key_uint(&writer, key, milestones[i].us / 1000);
+        if (milestones[i].retries) {
+            snprintf(key, sizeof(key), "%s_retries", milestone_names[i]);
+            json_key_uint(&writer, key, milestones[i].retries);
+        }
+    }
+    json_end_object(&writer);
+    if (json_end(&writer) > 0)
+        event_batch_publish(eventbuf, EVENT_PRIORITY_BULK);
+
+#ifdef M1_DEBUG
+    char line[40];
+    for (int i = 0; i < BOOT_MILESTONE_COUNT; i++) {
+        snprintf(line, sizeof(line), "%-10s %6lu ms %u", milestone_names[i],
+                 milestones[i].reached ? (unsigned long)(milestones[i].us / 1000) : 0, milestones[i].retries);
+        BufferLine(4 + i, line);
+    }
+    PaintText();
+#endif
+}
+
+/******************************************************************************
+* Function Name: boot_mark
+* Description  : Records that a milestone was reached. Only the first call
+*                for each milestone counts. Reaching BOOT_FIRST_TELEMETRY
+*                publishes the timeline.
+* Arguments    : milestone –
+*                    milestone reached.
+******************************************************************************/
+void boot_mark(boot_milestone_t milestone) {
+    if (milestones[milestone].reached)
+        return;
+    milestones[milestone].us = timestamp_us();
+    milestones[milestone].reached = true;
+    if (milestone == BOOT_FIRST_TELEMETRY)
+        boot_timeline_publish();
+}
+
+/******************************************************************************
+* Function Name: boot_retry
+* Description  : Counts a failed attempt at reaching a milestone, until it is
+*                reached.
+* Arguments    : milestone –
+*                    milestone attempted.
+******************************************************************************/
+void boot_retry(boot_milestone_t milestone) {
+    if (!milestones[milestone].reached)
+        milestones[milestone].retries++;
+}
@@ -0,0 +1,48 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : boot_timeline.h
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Boot milestones, published once as the boot_timeline event.
+ ******************************************************************************/
+
+#ifndef BOOT_TIMELINE_H_
+#define BOOT_TIMELINE_H_
+
+/** Boot milestones, in the order they are normally reached. */
+typedef enum e_boot_milestone
+{
+    BOOT_LCD_START,         ///< gui_thread starts the LCD.
+    BOOT_LCD_READY,         ///< panel initialized and splash shown.
+    BOOT_PROVISION_DONE,    ///< provisioning-mode touch window closed.
+    BOOT_LINK_UP,           ///< access point joined.
+    BOOT_DHCP_DONE,         ///< address leased.
+    BOOT_DNS_DONE,          ///< broker resolved.
+    BOOT_MQTT_CONNECTED,    ///< broker connected.
+    BOOT_FIRST_TELEMETRY,   ///< first vibration window event queued.
+    BOOT_MILESTONE_COUNT
+} boot_milestone_t;
+
+void boot_mark(boot_milestone_t milestone);
+void boot_retry(boot_milestone_t milestone);
+
+#endif /* BOOT_TIMELINE_H_ */
@@ -0,0 +1,274 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : bus_schedule.c
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : With the accelerometer read over I2C on the shared cloud
+ *                driver bus (I2C_VIBRATION and USE_SHARED_BUS, through
+ *                g_sf_i2c_device4 on g_sf_i2c_bus0), a long
+ *                cloud read could hold the bus over several vibration
+ *                samples. The vibration thread marks each sample with
+ *                bus_schedule_sample_begin and bus_schedule_sample_end,
+ *                which reserves a slot every BUS_SCHEDULE_SAMPLE_US. Every
+ *                cloud driver command goes through bus_schedule_command,
+ *                which estimates the transaction time from its lengths and
+ *                only starts it if it ends before the next slot. Otherwise
+ *                it is deferred until the next sample ends, so the gap
+ *                after a sample is free for it. A transaction which does
+ *                not fit even there, twice, cannot be split, since the
+ *                cloud driver runs it as one transfer, so it goes right
+ *                after a sample and is counted as an overrun. The sample interval
+ *                is timed with timestamp_us, and its deviation from the
+ *                period is reported as jitter in the bus_schedule
+ *                statistics event. Without BUS_SCHEDULE, as with the
+ *                default SPI accelerometer, every I2C call passes straight
+ *                through; tools/bus_schedule_test.c runs the scheduler on
+ *                a simulated bus. UART commands instead take the UART from
+ *                the background stream (see uart_stream) while they run.
+ ******************************************************************************/
+
+#include <app.h>
+#include "tx_api.h"
+#include "bus_schedule.h"
+#include "json_writer.h"
+#include "read_cache.h"
+#include "timestamp.h"
+#include "uart_stream.h"
+#include <m1_cloud_driver.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef BUS_SCHEDULE
+
+// bus_schedule_flags
+#define BUS_SCHEDULE_SAMPLE_FLAG    0x01
+// gaps after a sample a transaction waits for before it overruns
+#define BUS_SCHEDULE_GAPS           2
+
+static TX_MUTEX bus_schedule_mutex;
+static TX_EVENT_FLAGS_GROUP bus_schedule_flags;
+// time stamp of the start of the last sample
+static uint32_t last_sample;
+static bool sampling = false;
+// between bus_schedule_sample_begin and _end, the sample may hold the bus
+static bool in_sample = false;
+
+// statistics since the last statistics event
+static uint32_t samples = 0;
+static uint32_t jitter_tot = 0;
+static uint32_t jitter_max = 0;
+static uint32_t deferred = 0;
+static uint32_t overruns = 0;
+static uint32_t wait_max = 0;
+
+/******************************************************************************
+* Function Name: bus_schedule_wait
+* Description  : Waits until a cloud transaction can run without reaching
+*                into the next sample slot. Called with the mutex held.
+* Arguments    : need_us –
+*                    estimated transaction time.
+******************************************************************************/
+static void bus_schedule_wait(uint32_t need_us) {
+    uint32_t start = timestamp_us();
+    // sample ends waited for
+    uint32_t gaps = 0;
+    bool waited = false;
+    ULONG actual;
+
+    tx_event_flags_get(&bus_schedule_flags, BUS_SCHEDULE_SAMPLE_FLAG, TX_OR_CLEAR, &actual, TX_NO_WAIT);
+    while (1) {
+        uint32_t elapsed_us = timestamp_us() - last_sample;
+
+        // no sampling stream to protect
+        if (!sampling || elapsed_us > 2 * BUS_SCHEDULE_SAMPLE_US)
+            break;
+        // a transaction only starts once the sample has the bus no more
+        if (!in_sample && elapsed_us + need_us <= BUS_SCHEDULE_SAMPLE_US)
+            break;
+        // right after a sample the gap is as long as it gets, unless that
+        // sample was held up itself, so a transaction gets two gaps
+        if (!in_sample && gaps == BUS_SCHEDULE_GAPS) {
+            overruns++;
+            break;
+        }
+        if (!waited)
+            deferred++;
+        waited = true;
+        if (tx_event_flags_get(&bus_schedule_flags, BUS_SCHEDULE_SAMPLE_FLAG, TX_OR_CLEAR, &actual, 2) == TX_SUCCESS)
+            gaps++;
+    }
+
+    uint32_t wait_us = timestamp_us() - start;
+    if (wait_us > wait_max)
+        wait_max = wait_us;
+}
+
+#endif
+
+/******************************************************************************
+* Function Name: bus_schedule_init
+* Description  : Creates the scheduler mutex and flags. Must be called once,
+*                before any cloud driver command or vibration sample.
+******************************************************************************/
+void bus_schedule_init(void) {
+#ifdef BUS_SCHEDULE
+    UINT status = tx_mutex_create(&bus_schedule_mutex, "Bus Schedule Mutex", TX_NO_INHERIT);
+    APP_ERR_TRAP(status);
+    status = tx_event_flags_create(&bus_schedule_flags, "Bus Schedule Flags");
+    APP_ERR_TRAP(status);
+#endif
+}
+
+/******************************************************************************
+* Function Name: bus_schedule_sample_begin
+* Description  : Marks the start of a vibration sample and measures its
+*                jitter. Intervals over two periods are pauses of the
+*                stream, not jitter, and are skipped.
+******************************************************************************/
+void bus_schedule_sample_begin(void) {
+#ifdef BUS_SCHEDULE
+    uint32_t now = timestamp_us();
+
+    if (sampling) {
+        uint32_t interval_us = now - last_sample;
+        if (interval_us <= 2 * BUS_SCHEDULE_SAMPLE_US) {
+            uint32_t jitter = (interval_us > BUS_SCHEDULE_SAMPLE_US) ? interval_us - BUS_SCHEDULE_SAMPLE_US
+                                                                     : BUS_SCHEDULE_SAMPLE_US - interval_us;
+            samples++;
+            jitter_tot += jitter;
+            if (jitter > jitter_max)
+                jitter_max = jitter;
+        }
+    }
+    last_sample = now;
+    sampling = true;
+    in_sample = true;
+#endif
+}
+
+/******************************************************************************
+* Function Name: bus_schedule_sample_end
+* Description  : Marks the end of a vibration sample, releasing deferred
+*                cloud transactions.
+******************************************************************************/
+void bus_schedule_sample_end(void) {
+#ifdef BUS_SCHEDULE
+    in_sample = false;
+    tx_event_flags_set(&bus_schedule_flags, BUS_SCHEDULE_SAMPLE_FLAG, TX_OR);
+#endif
+}
+
+/******************************************************************************
+* Function Name: bus_schedule_run
+* Description  : Runs a cloud driver command through m1_handle_message. I2C
+*                commands first wait for a gap between sample slots which
+*                fits them, one at a time; UART commands hold the UART
+*                stream.
+* Arguments    : p_command –
+*                    null-terminated cloud driver command.
+*                p_reply -
+*                    buffer for the reply, as for m1_handle_message.
+* Return Value : result of m1_handle_message.
+******************************************************************************/
+static int bus_schedule_run(const char * p_command, char * p_reply) {
+    int status;
+
+    if (!strncmp(p_command, "1;", 2)) {
+        uart_stream_hold();
+        status = m1_handle_message(p_command, p_reply);
+        uart_stream_release();
+        return status;
+    }
+#ifdef BUS_SCHEDULE
+    unsigned int read_length;
+    unsigned int write_length;
+
+    if (sscanf(p_command, "3;2;%u;%u;", &read_length, &write_length) != 2)
+        return m1_handle_message(p_command, p_reply);
+    tx_mutex_get(&bus_schedule_mutex, TX_WAIT_FOREVER);
+    bus_schedule_wait(BUS_SCHEDULE_GUARD_US + (read_length + write_length) * BUS_SCHEDULE_BYTE_US);
+    status = m1_handle_message(p_command, p_reply);
+    tx_mutex_put(&bus_schedule_mutex);
+    return status;
+#else
+    return m1_handle_message(p_command, p_reply);
+#endif
+}
+
+/******************************************************************************
+* Function Name: bus_schedule_command
+* Description  : Runs a cloud driver command, as bus_schedule_run. A command
+*                which returns no data, such as a write, flushes the read
+*                cache of its port, wherever it came from.
+* Arguments    : p_command –
+*                    null-terminated cloud driver command.
+*                p_reply -
+*                    buffer for the reply, as for m1_handle_message.
+* Return Value : result of m1_handle_message.
+******************************************************************************/
+int bus_schedule_command(const char * p_command, char * p_reply) {
+    int status = bus_schedule_run(p_command, p_reply);
+
+    // a write may change what the reads of its port return
+    if (status == M1_SUCCESS_NO_DATA)
+        read_cache_flush(p_command[0]);
+    return status;
+}
+
+/******************************************************************************
+* Function Name: bus_schedule_stats
+* Description  : Writes the scheduler statistics event and starts a new
+*                statistics period.
+* Arguments    : p_buf –
+*                    buffer for the event.
+*                size -
+*                    size of p_buf.
+* Return Value : length of the event, -1 if it did not fit, or 0 without
+*                BUS_SCHEDULE.
+******************************************************************************/
+int bus_schedule_stats(char * p_buf, size_t size) {
+#ifdef BUS_SCHEDULE
+    json_writer_t writer;
+
+    json_begin(&writer, p_buf, size);
+    json_key_object(&writer, "bus_schedule");
+    json_key_uint(&writer, "samples", samples);
+    json_key_uint(&writer, "jitter_avg_us", samples ? jitter_tot / samples : 0);
+    json_key_uint(&writer, "jitter_max_us", jitter_max);
+    json_key_uint(&writer, "deferred", deferred);
+    json_key_uint(&writer, "overruns", overruns);
+    json_key_uint(&writer, "wait_max_us", wait_max);
+    json_end_object(&writer);
+    samples = 0;
+    jitter_tot = 0;
+    jitter_max = 0;
+    deferred = 0;
+    overruns = 0;
+    wait_max = 0;
+    return json_end(&writer);
+#else
+    SSP_PARAMETER_NOT_USED(p_buf);
+    SSP_PARAMETER_NOT_USED(size);
+    return 0;
+#endif
+}
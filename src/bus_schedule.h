@@ -0,0 +1,58 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : bus_schedule.h
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Keeps cloud driver transactions out of the vibration
+ *                sample slots on a shared I2C bus.
+ ******************************************************************************/
+
+#ifndef BUS_SCHEDULE_H_
+#define BUS_SCHEDULE_H_
+
+#include <app.h>
+#include <stddef.h>
+
+// only the accelerometer on the shared cloud driver bus needs scheduling;
+// the default SPI accelerometer leaves the I2C bus to the cloud driver
+#if defined(I2C_VIBRATION) && defined(USE_SHARED_BUS)
+#define BUS_SCHEDULE
+#endif
+
+// reply buffer of a cloud driver command (bytes), which m1_handle_message
+// fills without a size; every caller sizes its buffer by this
+#define BUS_SCHEDULE_REPLY_SIZE 700
+// vibration sample period (us), one SLEEP_STEP tick
+#define BUS_SCHEDULE_SAMPLE_US  10000
+// transfer time per byte at the standard 100 kHz rate (us)
+#define BUS_SCHEDULE_BYTE_US    90
+// start, address, stop and driver overhead per transaction, and the wake
+// latency of the vibration thread (us)
+#define BUS_SCHEDULE_GUARD_US   500
+
+void bus_schedule_init(void);
+void bus_schedule_sample_begin(void);
+void bus_schedule_sample_end(void);
+int bus_schedule_command(const char * p_command, char * p_reply);
+int bus_schedule_stats(char * p_buf, size_t size);
+
+#endif /* BUS_SCHEDULE_H_ */
@@ -0,0 +1,189 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : chunked_read.c
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Streams reads larger than the cloud driver reply buffer,
+ *                such as EEPROM dumps or UART captures, as a sequence of
+ *                parts read into one reused buffer, so RAM use does not
+ *                depend on the read size. A read is requested with
+ *                    L<total>;<part>;<offset>;<offset_bytes>;<command>
+ *                where <command> is an I2C read & write command
+ *                (3;2;...;<TAG_NAME>;<address>) or a UART read
+ *                (1;0;...;<TAG_NAME>;) whose lengths are replaced for every
+ *                part. For I2C, <offset_bytes> (0 to 4) big-endian bytes of
+ *                <offset> plus the bytes already read are written after the
+ *                device address, as a memory address for EEPROMs; UART
+ *                parts simply continue the stream. Each part is published
+ *                as a reply event
+ *                    {"<tag>":...,"chunk":{"seq":<n>,"offset":<n>,
+ *                     "length":<n>,"total":<n>,"last":<bool>}}
+ *                with "error" set on the last part if a read failed, and
+ *                the request ID of the message, if any (see
+ *                command_trace). A part waits for room in the reply queue
+ *                rather than be dropped.
+ ******************************************************************************/
+
+#include <app.h>
+#include "tx_api.h"
+#include "chunked_read.h"
+#include "bus_schedule.h"
+#include "command_trace.h"
+#include "event_batch.h"
+#include "json_writer.h"
+#include <m1_cloud_driver.h>
+
+#include <stdio.h>
+#include <string.h>
+
+// longest tag of a chunked read
+#define CHUNKED_READ_TAG_MAX    64
+
+// only used by sensor_thread, so kept off its stack
+static char command[CHUNKED_READ_TAG_MAX + 32];
+static char reply[BUS_SCHEDULE_REPLY_SIZE];
+static char part[BUS_SCHEDULE_REPLY_SIZE + 96];
+
+/******************************************************************************
+* Function Name: chunked_read_publish
+* Description  : Queues a part with the request ID of its message, waiting
+*                while the reply queue is full. A part without room for
+*                the ID still goes out.
+* Arguments    : p_message –
+*                    null-terminated chunked read message, with its
+*                    prefixes.
+* Return Value : true if the part was queued.
+******************************************************************************/
+static bool chunked_read_publish(const char * p_message) {
+    ULONG waited = 0;
+
+    command_trace_id(p_message, part, sizeof(part));
+    while (event_batch_publish(part, EVENT_PRIORITY_REPLY)) {
+        if (waited >= CHUNKED_READ_QUEUE_WAIT)
+            return false;
+        tx_thread_sleep(10);
+        waited += 10;
+    }
+    return true;
+}
+
+/******************************************************************************
+* Function Name: chunked_read_error
+* Description  : Reports a chunked read which could not be started.
+* Arguments    : p_message –
+*                    null-terminated chunked read message, with its
+*                    prefixes.
+*                status -
+*                    M1_ERROR code.
+******************************************************************************/
+static void chunked_read_error(const char * p_message, int status) {
+    json_writer_t writer;
+
+    json_begin(&writer, part, sizeof(part));
+    json_key_object(&writer, "chunk");
+    json_key_uint(&writer, "seq", 0);
+    json_key_bool(&writer, "last", true);
+    json_key_int(&writer, "error", status);
+    json_end_object(&writer);
+    if (json_end(&writer) > 0)
+        chunked_read_publish(p_message);
+}
+
+/******************************************************************************
+* Function Name: chunked_read_run
+* Description  : Runs a chunked read, publishing each part as it is read.
+* Arguments    : p_message –
+*                    null-terminated chunked read message, with its
+*                    prefixes; CHUNKED_READ_MARKER follows the request ID.
+******************************************************************************/
+void chunked_read_run(const char * p_message) {
+    unsigned int total;
+    unsigned int part_max;
+    unsigned int offset;
+    unsigned int offset_bytes;
+    unsigned int ignored;
+    unsigned int write_length;
+    int n = 0;
+    int m = 0;
+    bool i2c;
+    const char * p_read = command_trace_command_of(p_message);
+
+    if (sscanf(&p_read[1], "%u;%u;%u;%u;%n", &total, &part_max, &offset, &offset_bytes, &n) != 4 || !n) {
+        chunked_read_error(p_message, M1_ERROR_BAD_HEADER);
+        return;
+    }
+    const char * p_command = &p_read[1 + n];
+    if (sscanf(p_command, "3;2;%u;%u;%n", &ignored, &write_length, &m) == 2 && m) {
+        i2c = true;
+    } else if (sscanf(p_command, "1;0;%u;%n", &ignored, &m) == 1 && m) {
+        i2c = false;
+    } else {
+        chunked_read_error(p_message, M1_ERROR_UNSUPPORTED_COMMAND);
+        return;
+    }
+    const char * p_tag = &p_command[m];
+    const char * p_tag_end = strchr(p_tag, ';');
+    if (p_tag_end == NULL || p_tag_end - p_tag >= CHUNKED_READ_TAG_MAX || offset_bytes > 4 ||
+        (i2c && p_tag_end[1] == '\0') || (!i2c && offset_bytes)) {
+        chunked_read_error(p_message, M1_ERROR_BAD_COMMAND);
+        return;
+    }
+    int tag_length = (int)(p_tag_end - p_tag);
+    char address = p_tag_end[1];
+    if (part_max == 0 || part_max > CHUNKED_READ_PART_MAX)
+        part_max = CHUNKED_READ_PART_MAX;
+
+    for (uint32_t done = 0, seq = 0; done < total; seq++) {
+        uint32_t length = (total - done < part_max) ? total - done : part_max;
+        json_writer_t writer;
+        int status;
+
+        if (i2c) {
+            int header = snprintf(command, sizeof(command), "3;2;%lu;%u;%.*s;", (unsigned long)length,
+                                  1 + offset_bytes, tag_length, p_tag);
+            uint32_t address_offset = offset + done;
+            command[header] = address;
+            for (unsigned int b = 0; b < offset_bytes; b++)
+                command[header + 1 + (int)b] = (char)(address_offset >> (8 * (offset_bytes - 1 - b)));
+            command[header + 1 + (int)offset_bytes] = '\0';
+        } else {
+            snprintf(command, sizeof(command), "1;0;%lu;%.*s;", (unsigned long)length, tag_length, p_tag);
+        }
+        status = bus_schedule_command(command, reply);
+
+        json_begin(&writer, part, sizeof(part));
+        if (status == M1_SUCCESS_DATA)
+            json_members(&writer, reply);
+        json_key_object(&writer, "chunk");
+        json_key_uint(&writer, "seq", seq);
+        json_key_uint(&writer, "offset", done);
+        json_key_uint(&writer, "length", length);
+        json_key_uint(&writer, "total", total);
+        done += length;
+        json_key_bool(&writer, "last", done >= total || status != M1_SUCCESS_DATA);
+        if (status != M1_SUCCESS_DATA)
+            json_key_int(&writer, "error", status);
+        json_end_object(&writer);
+        if (json_end(&writer) <= 0 || !chunked_read_publish(p_message) || status != M1_SUCCESS_DATA)
+            return;
+    }
+}
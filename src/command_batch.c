@@ -0,0 +1,146 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : command_batch.c
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Runs an ordered list of cloud driver commands back to back
+ *                and merges their replies into one event, so reading a
+ *                multi-register sensor takes one round trip and one
+ *                publish instead of one per command. A batch message is
+ *                    B<length>;<command><length>;<command>...
+ *                where each <command> is a cloud driver command of
+ *                <length> bytes (see m1_handle_message). The length prefix
+ *                lets the binary <DATA> of a command hold any byte but the
+ *                null. Cloud driver commands start with a port digit, so
+ *                the 'B' cannot clash with them. The reply is
+ *                    {"<tag>":...,"<tag>":...,"command_batch":{"done":<n>}}
+ *                with the members of every command that returned data, in
+ *                order, so tags must be unique within a batch. The batch
+ *                stops at the first failing command, and "error" then
+ *                holds its M1_ERROR code. A batch with an I2C command
+ *                holds the I2C bus throughout so no other device access
+ *                lands between two commands, except with BUS_SCHEDULE,
+ *                where that would shut out the vibration samples and each
+ *                command is scheduled on its own. Batches of GPIO and UART
+ *                commands leave the bus to the I2C worker.
+ ******************************************************************************/
+
+#include <app.h>
+#include "sensor_thread.h"
+#include "command_batch.h"
+#include "command_pool.h"
+#include "json_writer.h"
+#include "bus_schedule.h"
+#include <m1_cloud_driver.h>
+
+#include <stdio.h>
+#include <string.h>
+
+// only used by sensor_thread, so kept off its stack
+static char command[COMMAND_POOL_LARGE_SIZE];
+static char result[BUS_SCHEDULE_REPLY_SIZE];
+
+#if defined(I2C_OPEN) && !defined(BUS_SCHEDULE)
+/******************************************************************************
+* Function Name: command_batch_uses_i2c
+* Description  : Looks for an I2C read & write command (3;2) in a batch.
+* Arguments    : p –
+*                    commands of the batch, after COMMAND_BATCH_MARKER.
+* Return Value : true if the batch has one before its first bad header.
+******************************************************************************/
+static bool command_batch_uses_i2c(const char * p) {
+    while (*p) {
+        unsigned int length;
+        int n;
+
+        if (sscanf(p, "%u;%n", &length, &n) != 1 || strlen(&p[n]) < length)
+            return false;
+        if (length >= 4 && !strncmp(&p[n], "3;2;", 4))
+            return true;
+        p += n + (int)length;
+    }
+    return false;
+}
+#endif
+
+/******************************************************************************
+* Function Name: command_batch_run
+* Description  : Runs the commands of a batch in order and writes the merged
+*                reply.
+* Arguments    : p_batch –
+*                    null-terminated batch message, starting with
+*                    COMMAND_BATCH_MARKER.
+*                p_reply -
+*                    buffer for the reply event.
+*                size -
+*                    size of p_reply.
+* Return Value : length of the reply, or -1 if it did not fit.
+******************************************************************************/
+int command_batch_run(const char * p_batch, char * p_reply, size_t size) {
+    const char * p = &p_batch[1];
+    int status = M1_SUCCESS_NO_DATA;
+    uint32_t done = 0;
+    json_writer_t writer;
+#if defined(I2C_OPEN) && !defined(BUS_SCHEDULE)
+    bool locked = command_batch_uses_i2c(p);
+#endif
+
+    json_begin(&writer, p_reply, size);
+#if defined(I2C_OPEN) && !defined(BUS_SCHEDULE)
+    if (locked)
+        g_sf_i2c_device0.p_api->lockWait(g_sf_i2c_device0.p_ctrl, TX_WAIT_FOREVER);
+#endif
+    while (*p) {
+        unsigned int length;
+        int n;
+
+        if (done == COMMAND_BATCH_MAX) {
+            status = M1_ERROR_BUFFER_OVERFLOW;
+            break;
+        }
+        if (sscanf(p, "%u;%n", &length, &n) != 1 || length >= sizeof(command) || strlen(&p[n]) < length) {
+            status = M1_ERROR_BAD_HEADER;
+            break;
+        }
+        memcpy(command, &p[n], length);
+        command[length] = '\0';
+        p += n + (int)length;
+
+        status = bus_schedule_command(command, result);
+        if (status == M1_SUCCESS_DATA)
+            json_members(&writer, result);
+        else if (status != M1_SUCCESS_NO_DATA)
+            break;
+        done++;
+    }
+#if defined(I2C_OPEN) && !defined(BUS_SCHEDULE)
+    if (locked)
+        g_sf_i2c_device0.p_api->unlock(g_sf_i2c_device0.p_ctrl);
+#endif
+
+    json_key_object(&writer, "command_batch");
+    json_key_uint(&writer, "done", done);
+    if (status != M1_SUCCESS_DATA && status != M1_SUCCESS_NO_DATA)
+        json_key_int(&writer, "error", status);
+    json_end_object(&writer);
+    return json_end(&writer);
+}
@@ -0,0 +1,172 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : command_pool.c
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Buffers for cloud driver commands, taken from three ThreadX
+ *                block pools instead of the heap. Fixed blocks cannot
+ *                fragment and both allocation and release take constant
+ *                time. A buffer is owned by m1_message_callback until it is
+ *                sent on g_cloud_driver_command_queue, and by sensor_thread
+ *                from the moment it is received; whoever owns it last
+ *                releases it with command_pool_free. Allocation never
+ *                waits, as it runs on the M1 agent thread: a command which
+ *                finds its class and every larger class empty, or is
+ *                longer than the large class, is dropped and counted, and
+ *                m1_message_callback answers it with an error.
+ ******************************************************************************/
+
+#include <app.h>
+#include "tx_api.h"
+#include "command_pool.h"
+#include "json_writer.h"
+
+// ThreadX keeps a pointer in front of every block
+#define COMMAND_POOL_BLOCK_OVERHEAD sizeof(void *)
+
+typedef struct command_pool_class
+{
+    TX_BLOCK_POOL   pool;
+    const char *    name;
+    size_t          size;
+    uint32_t        count;
+    // statistics since the last statistics event
+    uint32_t        allocs;
+    uint32_t        failures;
+    uint32_t        high_water;
+} command_pool_class_t;
+
+static ULONG small_memory[COMMAND_POOL_SMALL_COUNT * (COMMAND_POOL_SMALL_SIZE + COMMAND_POOL_BLOCK_OVERHEAD) / sizeof(ULONG)];
+static ULONG medium_memory[COMMAND_POOL_MEDIUM_COUNT * (COMMAND_POOL_MEDIUM_SIZE + COMMAND_POOL_BLOCK_OVERHEAD) /
+                           sizeof(ULONG)];
+static ULONG large_memory[COMMAND_POOL_LARGE_COUNT * (COMMAND_POOL_LARGE_SIZE + COMMAND_POOL_BLOCK_OVERHEAD) / sizeof(ULONG)];
+
+static command_pool_class_t classes[] =
+{
+    { .name = "small", .size = COMMAND_POOL_SMALL_SIZE, .count = COMMAND_POOL_SMALL_COUNT },
+    { .name = "medium", .size = COMMAND_POOL_MEDIUM_SIZE, .count = COMMAND_POOL_MEDIUM_COUNT },
+    { .name = "large", .size = COMMAND_POOL_LARGE_SIZE, .count = COMMAND_POOL_LARGE_COUNT },
+};
+
+// allocations which found no buffer, since the last statistics event
+static uint32_t dropped = 0;
+
+/******************************************************************************
+* Function Name: command_pool_init
+* Description  : Creates the block pools. Must be called once, before the
+*                cloud connection is made.
+******************************************************************************/
+void command_pool_init(void) {
+    UINT status = tx_block_pool_create(&classes[0].pool, "Command Pool Small", COMMAND_POOL_SMALL_SIZE,
+                                       small_memory, sizeof(small_memory));
+    APP_ERR_TRAP(status);
+    status = tx_block_pool_create(&classes[1].pool, "Command Pool Medium", COMMAND_POOL_MEDIUM_SIZE,
+                                  medium_memory, sizeof(medium_memory));
+    APP_ERR_TRAP(status);
+    status = tx_block_pool_create(&classes[2].pool, "Command Pool Large", COMMAND_POOL_LARGE_SIZE,
+                                  large_memory, sizeof(large_memory));
+    APP_ERR_TRAP(status);
+}
+
+/******************************************************************************
+* Function Name: command_pool_alloc
+* Description  : Takes a buffer from the smallest class that fits. Falls
+*                back to the next larger class when a class is empty.
+*                Never waits.
+* Arguments    : size –
+*                    bytes needed, including any terminator.
+* Return Value : The buffer, or NULL if no class has a free buffer of that
+*                size.
+******************************************************************************/
+char * command_pool_alloc(size_t size) {
+    VOID * p_block;
+
+    for (unsigned int i = 0; i < sizeof(classes) / sizeof(classes[0]); i++) {
+        command_pool_class_t * p_class = &classes[i];
+        ULONG available;
+        uint32_t in_use;
+
+        if (size > p_class->size)
+            continue;
+        if (tx_block_allocate(&p_class->pool, &p_block, TX_NO_WAIT) != TX_SUCCESS) {
+            p_class->failures++;
+            continue;
+        }
+        p_class->allocs++;
+        tx_block_pool_info_get(&p_class->pool, TX_NULL, &available, TX_NULL, TX_NULL, TX_NULL, TX_NULL);
+        in_use = p_class->count - (uint32_t)available;
+        if (in_use > p_class->high_water)
+            p_class->high_water = in_use;
+        return p_block;
+    }
+    dropped++;
+    return NULL;
+}
+
+/******************************************************************************
+* Function Name: command_pool_free
+* Description  : Returns a buffer to its pool.
+* Arguments    : p_buf –
+*                    buffer from command_pool_alloc.
+******************************************************************************/
+void command_pool_free(char * p_buf) {
+    tx_block_release(p_buf);
+}
+
+/******************************************************************************
+* Function Name: command_pool_stats
+* Description  : Writes the pool statistics event and starts a new
+*                statistics period. Per class, failures counts the times
+*                the class was empty, and high_water the most buffers in
+*                use at once; dropped counts commands which got no buffer
+*                at all. high_water starts again from the buffers in use.
+* Arguments    : p_buf –
+*                    buffer for the event.
+*                size -
+*                    size of p_buf.
+* Return Value : length of the event, or -1 if it did not fit.
+******************************************************************************/
+int command_pool_stats(char * p_buf, size_t size) {
+    json_writer_t writer;
+
+    json_begin(&writer, p_buf, size);
+    json_key_object(&writer, "command_pool");
+    for (unsigned int i = 0; i < sizeof(classes) / sizeof(classes[0]); i++) {
+        command_pool_class_t * p_class = &classes[i];
+        ULONG available;
+
+        json_key_object(&writer, p_class->name);
+        json_key_uint(&writer, "allocs", p_class->allocs);
+        json_key_uint(&writer, "failures", p_class->failures);
+        json_key_uint(&writer, "high_water", p_class->high_water);
+        json_key_uint(&writer, "count", p_class->count);
+        json_end_object(&writer);
+        tx_block_pool_info_get(&p_class->pool, TX_NULL, &available, TX_NULL, TX_NULL, TX_NULL, TX_NULL);
+        p_class->allocs = 0;
+        p_class->failures = 0;
+        p_class->high_water = p_class->count - (uint32_t)available;
+    }
+    json_key_uint(&writer, "dropped", dropped);
+    json_end_object(&writer);
+    dropped = 0;
+    return json_end(&writer);
+}
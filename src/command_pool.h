@@ -0,0 +1,60 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : command_pool.h
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Fixed-size buffers for cloud driver commands.
+ ******************************************************************************/
+
+#ifndef COMMAND_POOL_H_
+#define COMMAND_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "i2c_worker.h"
+
+// messages g_cloud_driver_command_queue holds (queue_size 1600 bytes of
+// 2-word messages in configuration.xml)
+#define COMMAND_POOL_QUEUE_DEPTH    200
+// buffers held off the queue: the sensor thread's command, and the queue
+// (I2C_WORKER_QUEUE_DEPTH) and running command of the I2C worker
+#define COMMAND_POOL_HELD           (1 + I2C_WORKER_QUEUE_DEPTH + 1)
+// size classes (bytes including the terminator) and buffers per class. The
+// large class takes the largest MQTT payload, one network packet
+// (BLOCK_SIZE in net_thread_entry.c). There is a buffer for every command
+// that can be queued or held, as long as the commands are short.
+#define COMMAND_POOL_SMALL_SIZE     80
+#define COMMAND_POOL_SMALL_COUNT    (COMMAND_POOL_QUEUE_DEPTH + COMMAND_POOL_HELD - COMMAND_POOL_MEDIUM_COUNT - \
+                                     COMMAND_POOL_LARGE_COUNT)
+#define COMMAND_POOL_MEDIUM_SIZE    320
+#define COMMAND_POOL_MEDIUM_COUNT   12
+#define COMMAND_POOL_LARGE_SIZE     1536
+#define COMMAND_POOL_LARGE_COUNT    4
+// period of the command pool statistics event (ticks)
+#define COMMAND_POOL_STATS_PERIOD   (5 * 60 * 100)
+
+void command_pool_init(void);
+char * command_pool_alloc(size_t size);
+void command_pool_free(char * p_buf);
+int command_pool_stats(char * p_buf, size_t size);
+
+#endif /* COMMAND_POOL_H_ */
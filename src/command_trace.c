@@ -0,0 +1,284 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : command_trace.c
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Cloud driver replies only carry the tag of their command,
+ *                so with commands completing out of order on the sensor
+ *                thread and the I2C workers the cloud could not tell two
+ *                requests with the same tag apart. A message may start
+ *                with
+ *                    R<id>;
+ *                (up to COMMAND_TRACE_ID_SIZE - 1 characters, no quotes,
+ *                backslashes or semicolons), and the reply of a single
+ *                command or batch, every part of a chunked read, and the
+ *                answer to a poll, UART stream or GPIO capture
+ *                registration then carries "id":"<id>". A traced command
+ *                which returns no data is still answered, with
+ *                    {"status":<n>,"ms":<n>,"id":"<id>"}
+ *                so every request completes. Every message on
+ *                g_cloud_driver_command_queue carries the timestamp_us it
+ *                was received at, which gives the latency of each command and
+ *                the commands in flight for the command_trace statistics
+ *                event.
+ ******************************************************************************/
+
+#include <app.h>
+#include "tx_api.h"
+#include "sensor_thread.h"
+#include "command_trace.h"
+#include "event_batch.h"
+#include "json_writer.h"
+#include "timestamp.h"
+#include <m1_cloud_driver.h>
+
+#include <stdio.h>
+#include <string.h>
+
+// commands taken from the queue and not yet completed, by sensor_thread
+// and the I2C workers, so only changed with interrupts disabled
+static volatile uint32_t in_flight = 0;
+
+// statistics since the last statistics event, updated by sensor_thread,
+// the I2C workers and the M1 agent thread, so only with interrupts
+// disabled
+static uint32_t commands = 0;
+static uint64_t latency_tot = 0;    // us
+static uint32_t latency_max = 0;    // us
+static uint32_t in_flight_max = 0;
+static uint32_t queue_max = 0;
+
+/******************************************************************************
+* Function Name: command_trace_command_of
+* Description  : Skips the request ID prefix of a message.
+* Arguments    : p_message –
+*                    null-terminated message.
+* Return Value : the message after its R<id>; prefix, or p_message if it
+*                has none.
+******************************************************************************/
+const char * command_trace_command_of(const char * p_message) {
+    if (p_message[0] != COMMAND_TRACE_MARKER)
+        return p_message;
+    const char * p_end = strchr(p_message, ';');
+    return (p_end == NULL) ? p_message : p_end + 1;
+}
+
+/******************************************************************************
+* Function Name: command_trace_id
+* Description  : Adds the request ID of a message to a JSON object, after
+*                its other members.
+* Arguments    : p_message –
+*                    null-terminated message.
+*                p_json -
+*                    null-terminated JSON object, such as a reply.
+*                size -
+*                    size of p_json.
+* Return Value : length of p_json, or -1 if the ID did not fit and p_json
+*                is unchanged. A message without a valid ID leaves p_json
+*                unchanged.
+******************************************************************************/
+int command_trace_id(const char * p_message, char * p_json, size_t size) {
+    size_t length = strlen(p_json);
+    const char * p_id = &p_message[1];
+    size_t id_length = strcspn(p_id, ";\"\\");
+
+    if (p_message[0] != COMMAND_TRACE_MARKER || p_id[id_length] != ';' || id_length >= COMMAND_TRACE_ID_SIZE)
+        return (int)length;
+    char * p_last = strrchr(p_json, '}');
+    if (p_last == NULL)
+        return (int)length;
+
+    const char * p_before = p_last;
+    while (p_before > p_json && (p_before[-1] == ' ' || p_before[-1] == '\n' || p_before[-1] == '\r'))
+        p_before--;
+    bool empty = (p_before > p_json && p_before[-1] == '{');
+    size_t tail = strlen(p_last);
+    size_t added = (empty ? 0u : 1u) + 6 + id_length + 1;
+    if (length + added >= size)
+        return -1;
+
+    memmove(p_last + added, p_last, tail + 1);
+    snprintf(p_last, added + 1, "%s\"id\":\"%.*s\"", empty ? "" : ",", (int)id_length, p_id);
+    p_last[added] = '}';
+    return (int)(length + added);
+}
+
+/******************************************************************************
+* Function Name: command_trace_reply
+* Description  : Publishes the result of a single command: the reply with
+*                its ID if there is data, otherwise a completion event if
+*                the message has an ID.
+* Arguments    : p_message –
+*                    null-terminated message, with its prefixes.
+*                status -
+*                    result of the command.
+*                queued -
+*                    timestamp_us the message was received at.
+*                p_reply -
+*                    reply of the command, also used to build the
+*                    completion event.
+*                size -
+*                    size of p_reply.
+******************************************************************************/
+void command_trace_reply(const char * p_message, int status, uint32_t queued, char * p_reply, size_t size) {
+    json_writer_t writer;
+
+    // a reply without room for its ID still goes out, by its tag
+    if (status == M1_SUCCESS_DATA) {
+        command_trace_id(p_message, p_reply, size);
+        event_batch_publish(p_reply, EVENT_PRIORITY_REPLY);
+        return;
+    }
+    if (command_trace_command_of(p_message) == p_message)
+        return;
+    json_begin(&writer, p_reply, size);
+    json_key_int(&writer, "status", status);
+    json_key_uint(&writer, "ms", (timestamp_us() - queued) / 1000);
+    json_end(&writer);
+    if (command_trace_id(p_message, p_reply, size) > 0)
+        event_batch_publish(p_reply, EVENT_PRIORITY_REPLY);
+}
+
+/******************************************************************************
+* Function Name: command_trace_refused
+* Description  : Answers a message which could not be queued with
+*                    {"status":<n>,"refused":"<reason>","length":<n>,"id":"<id>"}
+*                whether or not it has a request ID, so a command is never
+*                dropped silently. Runs on the M1 agent thread.
+* Arguments    : p_payload –
+*                    message as received, not null-terminated.
+*                length -
+*                    length of the message.
+*                p_reason -
+*                    "length" for a message longer than any command
+*                    buffer, "pool" when no buffer was free, "queue" when
+*                    g_cloud_driver_command_queue stayed full.
+******************************************************************************/
+void command_trace_refused(const char * p_payload, size_t length, const char * p_reason) {
+    // enough of the message for its R<id>; prefix
+    char message[COMMAND_TRACE_ID_SIZE + 2];
+    char reply[96];
+    json_writer_t writer;
+    size_t copied = (length < sizeof(message) - 1) ? length : sizeof(message) - 1;
+
+    memcpy(message, p_payload, copied);
+    message[copied] = '\0';
+    json_begin(&writer, reply, sizeof(reply));
+    json_key_int(&writer, "status", M1_ERROR_BUFFER_OVERFLOW);
+    json_key_string(&writer, "refused", p_reason);
+    json_key_uint(&writer, "length", (uint32_t)length);
+    if (json_end(&writer) > 0 && command_trace_id(message, reply, sizeof(reply)) > 0)
+        event_batch_publish(reply, EVENT_PRIORITY_REPLY);
+}
+
+/******************************************************************************
+* Function Name: command_trace_queued
+* Description  : Measures the queue depth after a message was sent to
+*                g_cloud_driver_command_queue.
+******************************************************************************/
+void command_trace_queued(void) {
+    ULONG enqueued;
+    TX_INTERRUPT_SAVE_AREA
+
+    tx_queue_info_get(&g_cloud_driver_command_queue, TX_NULL, &enqueued, TX_NULL, TX_NULL, TX_NULL, TX_NULL);
+    TX_DISABLE
+    if (enqueued > queue_max)
+        queue_max = (uint32_t)enqueued;
+    TX_RESTORE
+}
+
+/******************************************************************************
+* Function Name: command_trace_received
+* Description  : Counts a message taken from g_cloud_driver_command_queue as
+*                in flight.
+******************************************************************************/
+void command_trace_received(void) {
+    TX_INTERRUPT_SAVE_AREA
+
+    TX_DISABLE
+    in_flight++;
+    if (in_flight > in_flight_max)
+        in_flight_max = in_flight;
+    TX_RESTORE
+}
+
+/******************************************************************************
+* Function Name: command_trace_done
+* Description  : Counts a completed message and its latency.
+* Arguments    : queued –
+*                    timestamp_us the message was received at.
+******************************************************************************/
+void command_trace_done(uint32_t queued) {
+    uint32_t latency = timestamp_us() - queued;
+    TX_INTERRUPT_SAVE_AREA
+
+    TX_DISABLE
+    in_flight--;
+    commands++;
+    latency_tot += latency;
+    if (latency > latency_max)
+        latency_max = latency;
+    TX_RESTORE
+}
+
+/******************************************************************************
+* Function Name: command_trace_stats
+* Description  : Writes the pipeline statistics event and starts a new
+*                statistics period. The statistics are taken and reset in
+*                one step, so a command completing meanwhile counts in
+*                exactly one period. in_flight_max starts again from the
+*                commands in flight.
+* Arguments    : p_buf –
+*                    buffer for the event.
+*                size -
+*                    size of p_buf.
+* Return Value : length of the event, or -1 if it did not fit.
+******************************************************************************/
+int command_trace_stats(char * p_buf, size_t size) {
+    json_writer_t writer;
+    TX_INTERRUPT_SAVE_AREA
+
+    TX_DISABLE
+    uint32_t n = commands;
+    uint64_t tot = latency_tot;
+    uint32_t max = latency_max;
+    uint32_t flight = in_flight;
+    uint32_t flight_max = in_flight_max;
+    uint32_t depth_max = queue_max;
+    commands = 0;
+    latency_tot = 0;
+    latency_max = 0;
+    in_flight_max = in_flight;
+    queue_max = 0;
+    TX_RESTORE
+
+    json_begin(&writer, p_buf, size);
+    json_key_object(&writer, "command_trace");
+    json_key_uint(&writer, "commands", n);
+    json_key_uint(&writer, "latency_avg_ms", n ? (uint32_t)(tot / n / 1000) : 0);
+    json_key_uint(&writer, "latency_max_ms", max / 1000);
+    json_key_uint(&writer, "in_flight", flight);
+    json_key_uint(&writer, "in_flight_max", flight_max);
+    json_key_uint(&writer, "queue_max", depth_max);
+    json_end_object(&writer);
+    return json_end(&writer);
+}
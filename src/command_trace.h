@@ -0,0 +1,55 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : command_trace.h
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Request IDs and pipeline metrics of cloud driver commands.
+ ******************************************************************************/
+
+#ifndef COMMAND_TRACE_H_
+#define COMMAND_TRACE_H_
+
+#include "tx_api.h"
+#include <stddef.h>
+
+// first character of the optional R<id>; prefix of a message
+#define COMMAND_TRACE_MARKER    'R'
+// longest request ID, including the terminator
+#define COMMAND_TRACE_ID_SIZE   24
+
+// message of g_cloud_driver_command_queue (2 words)
+typedef struct command_trace_message
+{
+    char *  p_command;  ///< command pool buffer.
+    uint32_t queued;    ///< timestamp_us when the message was received from the cloud.
+} command_trace_message_t;
+
+const char * command_trace_command_of(const char * p_message);
+int command_trace_id(const char * p_message, char * p_json, size_t size);
+void command_trace_reply(const char * p_message, int status, uint32_t queued, char * p_reply, size_t size);
+void command_trace_refused(const char * p_payload, size_t length, const char * p_reason);
+void command_trace_queued(void);
+void command_trace_received(void);
+void command_trace_done(uint32_t queued);
+int command_trace_stats(char * p_buf, size_t size);
+
+#endif /* COMMAND_TRACE_H_ */
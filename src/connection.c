@@ -0,0 +1,492 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : connection.c
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Brings the cloud connection up in stages: Wi-Fi link, DHCP
+ *                lease, DNS lookup of the broker and MQTT connection through
+ *                m1_auto_enroll_connect. Each stage is bounded, and a failed
+ *                stage is retried after a jittered exponential backoff
+ *                instead of at once, so an outage does not turn into a
+ *                flood of association, DHCP and DNS requests. A failure
+ *                which leaves the lower stages working is retried from the
+ *                failed stage; one which lost the address restarts from
+ *                DHCP.
+ *                Once up, the M1 agent keeps the MQTT session alive and
+ *                reconnects by itself. Publish results are fed back through
+ *                connection_publish_status, so the state still follows the
+ *                broker connection.
+ *                State changes set CONNECTION_UP_FLAG or
+ *                CONNECTION_DOWN_FLAG in connection_flags. Coming up is
+ *                published as
+ *                    {"connection":{"state":"up",...}}
+ *                with the time spent in each stage of the last attempt, and
+ *                coming back after the agent reconnected with down_ms.
+ *                TLS works in the static arena of the configuration, so
+ *                reconnects do not fragment the heap. The arena is filled
+ *                with CONNECTION_SSL_FILL before the first connection, and
+ *                the events report its high-water mark as tls_mem_used.
+ *                The last lease and broker address are kept in data-flash.
+ *                At boot the DHCP stage first asks for the cached address
+ *                (INIT-REBOOT, no DISCOVER), and falls back to discovery
+ *                if the server does not confirm it within
+ *                CONNECTION_REBOOT_TIMEOUT. With a cached broker address
+ *                the DNS stage is skipped; the agent resolves the broker
+ *                again itself, as it only takes a host name. An MQTT
+ *                failure drops the cached broker address.
+ ******************************************************************************/
+
+#include <app.h>
+#include "net_thread.h"
+#include "connection.h"
+#include "event_batch.h"
+#include "json_writer.h"
+#include "boot_timeline.h"
+#include "data_flash.h"
+#include "r_fmi.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// marks arena bytes which TLS never touched
+#define CONNECTION_SSL_FILL 0xA5
+
+#define CONNECTION_CACHE_MAGIC 0x4d314e43
+
+typedef struct connection_cache_record
+{
+    uint32_t    magic;
+    uint32_t    ip;
+    uint32_t    mask;
+    uint32_t    gateway;
+    uint32_t    dns;
+    uint32_t    broker;     ///< 0 if unknown.
+    uint32_t    checksum;
+} connection_cache_record_t;
+
+extern const fmi_instance_t g_fmi0;
+
+TX_EVENT_FLAGS_GROUP connection_flags;
+
+static volatile connection_state_t state = CONNECTION_STATE_LINK;
+static ULONG down_tick = 0;
+static bool dhcp_started = false;
+static const connection_cfg_t * p_connection_cfg = NULL;
+static connection_cache_record_t cache;
+static connection_cache_record_t cache_stored;
+static bool dhcp_reboot_tried = false;
+static bool dhcp_rebooted = false;
+static bool dns_cached = false;
+
+static const boot_milestone_t stage_milestones[CONNECTION_STATE_UP] =
+{
+    [CONNECTION_STATE_LINK] = BOOT_LINK_UP,
+    [CONNECTION_STATE_DHCP] = BOOT_DHCP_DONE,
+    [CONNECTION_STATE_DNS]  = BOOT_DNS_DONE,
+    [CONNECTION_STATE_MQTT] = BOOT_MQTT_CONNECTED,
+};
+
+static const char * const state_names[CONNECTION_STATE_COUNT] =
+{
+    [CONNECTION_STATE_LINK] = "link",
+    [CONNECTION_STATE_DHCP] = "dhcp",
+    [CONNECTION_STATE_DNS]  = "dns",
+    [CONNECTION_STATE_MQTT] = "mqtt",
+    [CONNECTION_STATE_UP]   = "up",
+};
+
+/******************************************************************************
+* Function Name: connection_init
+* Description  : Creates the connection event flags and seeds the backoff
+*                jitter from the unique ID, so that a fleet of boards which
+*                lost the same access point do not retry in step. Must be
+*                called once, before any thread waits on connection_flags.
+******************************************************************************/
+void connection_init(void) {
+    fmi_product_info_t * p_fmi_product_info;
+    unsigned int seed = 0;
+
+    UINT status = tx_event_flags_create(&connection_flags, "Connection Flags");
+    APP_ERR_TRAP(status);
+    status = tx_event_flags_set(&connection_flags, CONNECTION_DOWN_FLAG, TX_OR);
+    APP_ERR_TRAP(status);
+    g_fmi0.p_api->productInfoGet(&p_fmi_product_info);
+    for (unsigned int i = 0; i < sizeof(p_fmi_product_info->unique_id); i++)
+        seed = p_fmi_product_info->unique_id[i] + (seed << 6) + (seed << 16) - seed;
+    srand(seed);
+}
+
+/******************************************************************************
+* Function Name: connection_state
+* Description  : Returns the current connection state.
+******************************************************************************/
+connection_state_t connection_state(void) {
+    return state;
+}
+
+/******************************************************************************
+* Function Name: connection_set_state
+* Description  : Moves to a new state and updates connection_flags.
+* Arguments    : new_state –
+*                    state to move to.
+******************************************************************************/
+static void connection_set_state(connection_state_t new_state) {
+    bool was_up = state == CONNECTION_STATE_UP;
+
+    state = new_state;
+    if (new_state == CONNECTION_STATE_UP && !was_up) {
+        tx_event_flags_set(&connection_flags, (ULONG)~CONNECTION_DOWN_FLAG, TX_AND);
+        tx_event_flags_set(&connection_flags, CONNECTION_UP_FLAG, TX_OR);
+    } else if (new_state != CONNECTION_STATE_UP && was_up) {
+        down_tick = tx_time_get();
+        tx_event_flags_set(&connection_flags, (ULONG)~CONNECTION_UP_FLAG, TX_AND);
+        tx_event_flags_set(&connection_flags, CONNECTION_DOWN_FLAG, TX_OR);
+    }
+}
+
+/******************************************************************************
+* Function Name: cache_checksum
+* Description  : Simple additive checksum over the cache record, excluding
+*                the checksum word itself.
+* Arguments    : p_record –
+*                    record to check.
+* Return Value : The checksum.
+******************************************************************************/
+static uint32_t cache_checksum(const connection_cache_record_t * p_record) {
+    const uint32_t * p_word = (const uint32_t *)p_record;
+    uint32_t sum = 0;
+
+    for (unsigned int i = 0; i < offsetof(connection_cache_record_t, checksum) / sizeof(uint32_t); i++)
+        sum += p_word[i];
+    return ~sum;
+}
+
+/******************************************************************************
+* Function Name: connection_cache_load
+* Description  : Loads the cached lease and broker address from data-flash,
+*                or clears the cache if no valid record is stored.
+******************************************************************************/
+static void connection_cache_load(void) {
+    if (data_flash_read(DATA_FLASH_NETWORK_ADDRESS, &cache, sizeof(cache)) != SSP_SUCCESS
+            || cache.magic != CONNECTION_CACHE_MAGIC || cache.checksum != cache_checksum(&cache))
+        memset(&cache, 0, sizeof(cache));
+    cache_stored = cache;
+}
+
+/******************************************************************************
+* Function Name: connection_cache_save
+* Description  : Writes the cache to data-flash if it changed since it was
+*                loaded or last saved, so an unchanged network costs no
+*                flash erase.
+******************************************************************************/
+static void connection_cache_save(void) {
+    cache.magic = CONNECTION_CACHE_MAGIC;
+    cache.checksum = cache_checksum(&cache);
+    if (memcmp(&cache, &cache_stored, sizeof(cache)) == 0)
+        return;
+    if (data_flash_write(DATA_FLASH_NETWORK_ADDRESS, &cache, sizeof(cache)) == SSP_SUCCESS)
+        cache_stored = cache;
+}
+
+/******************************************************************************
+* Function Name: connection_dns_servers
+* Description  : Points the DNS client at the lease's server, with Google
+*                DNS as the fallback.
+* Arguments    : p_cfg –
+*                    connection configuration.
+******************************************************************************/
+static void connection_dns_servers(const connection_cfg_t * p_cfg) {
+    nx_dns_server_remove_all(p_cfg->p_dns);
+    if (cache.dns != 0)
+        nx_dns_server_add(p_cfg->p_dns, cache.dns);
+    if (cache.dns != IP_ADDRESS(8, 8, 8, 8))
+        nx_dns_server_add(p_cfg->p_dns, IP_ADDRESS(8, 8, 8, 8));
+}
+
+/******************************************************************************
+* Function Name: connection_dhcp
+* Description  : DHCP stage. Tries INIT-REBOOT with the cached address the
+*                first time, then full discovery. On success the
+*                lease is copied into the cache.
+* Arguments    : p_cfg –
+*                    connection configuration.
+* Return Value : M1_SUCCESS or M1_ERROR_UNABLE_TO_CONNECT.
+******************************************************************************/
+static int connection_dhcp(const connection_cfg_t * p_cfg) {
+    ULONG ip_status;
+    ULONG address, mask;
+    ULONG option[2];
+    UINT option_size;
+    bool resolved = false;
+
+    if (cache.ip != 0 && !dhcp_reboot_tried) {
+        dhcp_reboot_tried = true;
+        if (dhcp_started) {
+            nx_dhcp_stop(p_cfg->p_dhcp);
+            nx_dhcp_reinitialize(p_cfg->p_dhcp);
+        }
+        if (nx_dhcp_request_client_ip(p_cfg->p_dhcp, cache.ip, NX_TRUE) == NX_SUCCESS
+                && nx_dhcp_start(p_cfg->p_dhcp) == NX_SUCCESS) {
+            dhcp_started = true;
+            resolved = nx_ip_status_check(p_cfg->p_ip, NX_IP_ADDRESS_RESOLVED, &ip_status,
+                                          CONNECTION_REBOOT_TIMEOUT) == NX_SUCCESS;
+        }
+    }
+    dhcp_rebooted = resolved;
+    if (!resolved) {
+        // a lease from before the link was lost, or one the server refused, may be stale
+        if (dhcp_started) {
+            nx_dhcp_stop(p_cfg->p_dhcp);
+            nx_dhcp_reinitialize(p_cfg->p_dhcp);
+        }
+        if (nx_dhcp_start(p_cfg->p_dhcp) != NX_SUCCESS)
+            return M1_ERROR_UNABLE_TO_CONNECT;
+        dhcp_started = true;
+        if (nx_ip_status_check(p_cfg->p_ip, NX_IP_ADDRESS_RESOLVED, &ip_status, CONNECTION_DHCP_TIMEOUT) != NX_SUCCESS)
+            return M1_ERROR_UNABLE_TO_CONNECT;
+    }
+
+    if (nx_ip_address_get(p_cfg->p_ip, &address, &mask) == NX_SUCCESS) {
+        cache.ip = (uint32_t)address;
+        cache.mask = (uint32_t)mask;
+    }
+    option_size = sizeof(option);
+    if (nx_dhcp_user_option_retrieve(p_cfg->p_dhcp, NX_DHCP_OPTION_GATEWAYS, (UCHAR *)option, &option_size) == NX_SUCCESS)
+        cache.gateway = (uint32_t)option[0];
+    option_size = sizeof(option);
+    if (nx_dhcp_user_option_retrieve(p_cfg->p_dhcp, NX_DHCP_OPTION_DNS_SVR, (UCHAR *)option, &option_size) == NX_SUCCESS
+            && cache.dns != option[0]) {
+        cache.dns = (uint32_t)option[0];
+        connection_dns_servers(p_cfg);
+    }
+    return M1_SUCCESS;
+}
+
+/******************************************************************************
+* Function Name: connection_stage
+* Description  : Runs one stage of the connection.
+* Arguments    : p_cfg –
+*                    connection configuration.
+*                stage -
+*                    stage to run.
+* Return Value : M1_SUCCESS, or an M1 error code for the MQTT stage and
+*                M1_ERROR_UNABLE_TO_CONNECT for the other stages.
+******************************************************************************/
+static int connection_stage(const connection_cfg_t * p_cfg, connection_state_t stage) {
+    ULONG address;
+    int status;
+
+    switch (stage) {
+        case CONNECTION_STATE_LINK:
+            BufferLine(1, "Connecting to SSID:");
+            BufferLine(2, (char *)p_cfg->p_prov->ssid);
+            PaintText();
+            if (g_sf_wifi0.p_api->provisioningSet(g_sf_wifi0.p_ctrl, p_cfg->p_prov) != SSP_SUCCESS)
+                return M1_ERROR_UNABLE_TO_CONNECT;
+            return M1_SUCCESS;
+        case CONNECTION_STATE_DHCP:
+            BufferLine(1, "Connected. Resolving IP address...");
+            BufferLine(2, "");
+            PaintText();
+            return connection_dhcp(p_cfg);
+        case CONNECTION_STATE_DNS:
+            dns_cached = cache.broker != 0;
+            if (dns_cached)
+                return M1_SUCCESS;
+            BufferLine(1, "IP address resolved.");
+            BufferLine(2, "Resolving MQTT broker");
+            PaintText();
+            if (nx_dns_host_by_name_get(p_cfg->p_dns, (UCHAR *)p_cfg->mqtt_host, &address, CONNECTION_DNS_TIMEOUT) != NX_SUCCESS)
+                return M1_ERROR_UNABLE_TO_CONNECT;
+            cache.broker = (uint32_t)address;
+            return M1_SUCCESS;
+        case CONNECTION_STATE_MQTT:
+            BufferLine(1, "IP address resolved.");
+            BufferLine(2, "Connecting to MQTT");
+            PaintText();
+            // a single try, retries are paced by the backoff
+            status = m1_auto_enroll_connect(p_cfg->mqtt_host,
+                                            p_cfg->mqtt_port,
+                                            p_cfg->p_project,
+                                            NULL,
+                                            p_cfg->p_device,
+                                            p_cfg->device_id,
+                                            1,
+                                            1,
+                                            60,
+                                            1,
+                                            p_cfg->p_ssl_mem,
+                                            p_cfg->ssl_mem_size,
+                                            p_cfg->p_pool,
+                                            p_cfg->p_ip,
+                                            p_cfg->p_dns);
+            if (status == M1_ERROR_ALREADY_CONNECTED)
+                return M1_SUCCESS;
+            // the broker may have moved, look it up again next time
+            if (status != M1_SUCCESS)
+                cache.broker = 0;
+            return status;
+        default:
+            return M1_SUCCESS;
+    }
+}
+
+/******************************************************************************
+* Function Name: connection_ssl_used
+* Description  : Finds the high-water mark of the TLS arena.
+* Return Value : bytes of the arena up to the last one TLS has written, 0 if
+*                there is no arena.
+******************************************************************************/
+static uint32_t connection_ssl_used(void) {
+    const uint8_t * p_mem;
+    int used;
+
+    if (p_connection_cfg == NULL || p_connection_cfg->p_ssl_mem == NULL)
+        return 0;
+    p_mem = p_connection_cfg->p_ssl_mem;
+    used = p_connection_cfg->ssl_mem_size;
+    while (used > 0 && p_mem[used - 1] == CONNECTION_SSL_FILL)
+        used--;
+    return (uint32_t)used;
+}
+
+/******************************************************************************
+* Function Name: connection_event
+* Description  : Queues the connection state event.
+* Arguments    : attempts –
+*                    failed stage attempts before the connection came up.
+*                stage_ms -
+*                    time spent in the successful run of each stage, NULL
+*                    when the agent reconnected by itself.
+*                total_ms -
+*                    time from the start of the first attempt, or for a
+*                    reconnection, the time the connection was down.
+******************************************************************************/
+static void connection_event(uint32_t attempts, const uint32_t * stage_ms, uint32_t total_ms) {
+    char eventbuf[256];
+    json_writer_t writer;
+
+    json_begin(&writer, eventbuf, sizeof(eventbuf));
+    json_key_object(&writer, "connection");
+    json_key_string(&writer, "state", state_names[state]);
+    json_key_uint(&writer, "attempts", attempts);
+    if (stage_ms != NULL) {
+        json_key_uint(&writer, "link_ms", stage_ms[CONNECTION_STATE_LINK]);
+        json_key_uint(&writer, "dhcp_ms", stage_ms[CONNECTION_STATE_DHCP]);
+        json_key_uint(&writer, "dns_ms", stage_ms[CONNECTION_STATE_DNS]);
+        json_key_uint(&writer, "mqtt_ms", stage_ms[CONNECTION_STATE_MQTT]);
+        json_key_uint(&writer, "total_ms", total_ms);
+        json_key_bool(&writer, "dhcp_reboot", dhcp_rebooted);
+        json_key_bool(&writer, "dns_cached", dns_cached);
+    } else {
+        json_key_uint(&writer, "down_ms", total_ms);
+    }
+    json_key_uint(&writer, "tls_mem_used", connection_ssl_used());
+    json_end_object(&writer);
+    if (json_end(&writer) > 0)
+        event_batch_publish(eventbuf, EVENT_PRIORITY_REPLY);
+}
+
+/******************************************************************************
+* Function Name: connection_run
+* Description  : Runs the stages in order until the connection is up. After
+*                a failure, waits between half and all of the current
+*                backoff, then doubles the backoff up to
+*                CONNECTION_BACKOFF_MAX. Credential and URL errors go
+*                straight to the longest backoff, as retrying soon cannot
+*                fix them. Blocks the calling thread only.
+* Arguments    : p_cfg –
+*                    connection configuration, kept by the caller.
+******************************************************************************/
+void connection_run(const connection_cfg_t * p_cfg) {
+    uint32_t stage_ms[CONNECTION_STATE_COUNT] = {0};
+    ULONG start = tx_time_get();
+    ULONG backoff = CONNECTION_BACKOFF_MIN;
+    uint32_t attempts = 0;
+    connection_state_t stage = CONNECTION_STATE_LINK;
+    char msg[32];
+
+    p_connection_cfg = p_cfg;
+    if (p_cfg->p_ssl_mem != NULL)
+        memset(p_cfg->p_ssl_mem, CONNECTION_SSL_FILL, (size_t)p_cfg->ssl_mem_size);
+    connection_cache_load();
+    connection_dns_servers(p_cfg);
+    while (stage != CONNECTION_STATE_UP) {
+        ULONG stage_start = tx_time_get();
+        ULONG ip_status;
+        ULONG delay;
+        int status;
+
+        connection_set_state(stage);
+        status = connection_stage(p_cfg, stage);
+        if (status == M1_SUCCESS) {
+            stage_ms[stage] = (uint32_t)(tx_time_get() - stage_start) * 10;
+            boot_mark(stage_milestones[stage]);
+            stage = (connection_state_t)(stage + 1);
+            continue;
+        }
+
+        attempts++;
+        boot_retry(stage_milestones[stage]);
+        if (status == M1_ERROR_BAD_CREDENTIALS || status == M1_ERROR_INVALID_URL)
+            backoff = CONNECTION_BACKOFF_MAX;
+        delay = backoff / 2 + (ULONG)rand() % (backoff / 2 + 1);
+        snprintf(msg, sizeof(msg), "Retrying in %lu s", (delay + 99) / 100);
+        BufferLine(2, msg);
+        PaintText();
+        tx_thread_sleep(delay);
+        backoff = (backoff * 2 < CONNECTION_BACKOFF_MAX) ? backoff * 2 : CONNECTION_BACKOFF_MAX;
+
+        // DHCP failing usually means the access point went away
+        if (stage == CONNECTION_STATE_DHCP)
+            stage = CONNECTION_STATE_LINK;
+        else if (stage > CONNECTION_STATE_DHCP
+                 && nx_ip_status_check(p_cfg->p_ip, NX_IP_ADDRESS_RESOLVED, &ip_status, NX_NO_WAIT) != NX_SUCCESS)
+            stage = CONNECTION_STATE_DHCP;
+    }
+    connection_set_state(CONNECTION_STATE_UP);
+    connection_cache_save();
+    BufferLine(1, "Connected!");
+    BufferLine(2, "");
+    PaintText();
+    connection_event(attempts, stage_ms, (uint32_t)(tx_time_get() - start) * 10);
+}
+
+/******************************************************************************
+* Function Name: connection_publish_status
+* Description  : Follows the broker connection from publish results, once
+*                connection_run has brought it up. M1_ERROR_NOT_CONNECTED
+*                means the agent lost the session and is reconnecting; the
+*                next successful publish means it is back.
+* Arguments    : status –
+*                    return value of m1_publish_event.
+******************************************************************************/
+void connection_publish_status(int status) {
+    if (status == M1_ERROR_NOT_CONNECTED && state == CONNECTION_STATE_UP) {
+        connection_set_state(CONNECTION_STATE_MQTT);
+    } else if (status == M1_SUCCESS && state == CONNECTION_STATE_MQTT) {
+        connection_set_state(CONNECTION_STATE_UP);
+        connection_event(0, NULL, (uint32_t)(tx_time_get() - down_tick) * 10);
+    }
+}
@@ -0,0 +1,87 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : connection.h
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Cloud connection state machine with backoff.
+ ******************************************************************************/
+
+#ifndef CONNECTION_H_
+#define CONNECTION_H_
+
+#include "tx_api.h"
+#include "nx_api.h"
+#include "nx_dhcp.h"
+#include "nx_dns.h"
+#include "sf_wifi_api.h"
+
+#include <m1_agent.h>
+
+// connection_flags
+#define CONNECTION_UP_FLAG      0x01
+#define CONNECTION_DOWN_FLAG    0x02
+
+// retry delay before jitter (ticks), doubled after each failure
+#define CONNECTION_BACKOFF_MIN  100
+#define CONNECTION_BACKOFF_MAX  (5 * 60 * 100)
+
+// longest wait for each stage (ticks)
+#define CONNECTION_DHCP_TIMEOUT (30 * 100)
+#define CONNECTION_DNS_TIMEOUT  (10 * 100)
+// wait for the server to confirm the cached lease before full discovery
+#define CONNECTION_REBOOT_TIMEOUT   (3 * 100)
+
+/** Stages of bringing the connection up, in order. */
+typedef enum e_connection_state
+{
+    CONNECTION_STATE_LINK,      ///< joining the access point.
+    CONNECTION_STATE_DHCP,      ///< waiting for an address lease.
+    CONNECTION_STATE_DNS,       ///< resolving the broker.
+    CONNECTION_STATE_MQTT,      ///< connecting to the broker, or the agent is reconnecting.
+    CONNECTION_STATE_UP,
+    CONNECTION_STATE_COUNT
+} connection_state_t;
+
+typedef struct connection_cfg
+{
+    sf_wifi_provisioning_t *        p_prov;
+    NX_PACKET_POOL *                p_pool;
+    NX_IP *                         p_ip;
+    NX_DHCP *                       p_dhcp;
+    NX_DNS *                        p_dns;
+    const char *                    mqtt_host;
+    int                             mqtt_port;
+    const project_credentials_t *   p_project;
+    user_credentials_t *            p_device;
+    const char *                    device_id;
+    void *                          p_ssl_mem;      ///< TLS arena, reused by every connection.
+    int                             ssl_mem_size;
+} connection_cfg_t;
+
+extern TX_EVENT_FLAGS_GROUP connection_flags;
+
+void connection_init(void);
+void connection_run(const connection_cfg_t * p_cfg);
+connection_state_t connection_state(void);
+void connection_publish_status(int status);
+
+#endif /* CONNECTION_H_ */
@@ -0,0 +1,98 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : data_flash.c
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Serialises access to the data-flash driver g_flash0, which
+ *                is shared by provisioning, calibration and other records.
+ *                The driver is opened and closed around every operation.
+ ******************************************************************************/
+
+#include <app.h>
+#include "net_thread.h"
+#include "data_flash.h"
+
+static TX_MUTEX data_flash_mutex;
+
+/******************************************************************************
+* Function Name: data_flash_init
+* Description  : Creates the data-flash mutex. Must be called once, before
+*                any other thread accesses data-flash.
+******************************************************************************/
+void data_flash_init(void) {
+    UINT status = tx_mutex_create(&data_flash_mutex, "Data Flash Mutex", TX_NO_INHERIT);
+    APP_ERR_TRAP(status);
+}
+
+/******************************************************************************
+* Function Name: data_flash_read
+* Description  : Reads a block of bytes from data-flash.
+* Arguments    : address –
+*                    data-flash address to read from.
+*                p_dest -
+*                    buffer to read into.
+*                size -
+*                    number of bytes to read.
+* Return Value : SSP_SUCCESS or the driver error.
+******************************************************************************/
+ssp_err_t data_flash_read(uint32_t address, void * p_dest, uint32_t size) {
+    ssp_err_t ssp_err;
+
+    tx_mutex_get(&data_flash_mutex, TX_WAIT_FOREVER);
+    ssp_err = g_flash0.p_api->open(g_flash0.p_ctrl, g_flash0.p_cfg);
+    if (ssp_err == SSP_SUCCESS) {
+        ssp_err = g_flash0.p_api->read(g_flash0.p_ctrl, p_dest, address, size);
+        g_flash0.p_api->close(g_flash0.p_ctrl);
+    }
+    tx_mutex_put(&data_flash_mutex);
+    return ssp_err;
+}
+
+/******************************************************************************
+* Function Name: data_flash_write
+* Description  : Erases the blocks covering a record and programs it. size is
+*                rounded up to DATA_FLASH_PROGRAMMING_UNIT, so p_src must be
+*                readable up to the rounded size.
+* Arguments    : address –
+*                    data-flash address to write to, block aligned.
+*                p_src -
+*                    data to write.
+*                size -
+*                    number of bytes to write.
+* Return Value : SSP_SUCCESS or the driver error.
+******************************************************************************/
+ssp_err_t data_flash_write(uint32_t address, const void * p_src, uint32_t size) {
+    ssp_err_t ssp_err;
+    uint32_t blocks = (size + DATA_FLASH_BLOCK_SIZE - 1) / DATA_FLASH_BLOCK_SIZE;
+
+    tx_mutex_get(&data_flash_mutex, TX_WAIT_FOREVER);
+    ssp_err = g_flash0.p_api->open(g_flash0.p_ctrl, g_flash0.p_cfg);
+    if (ssp_err == SSP_SUCCESS) {
+        ssp_err = g_flash0.p_api->erase(g_flash0.p_ctrl, address, blocks);
+        if (ssp_err == SSP_SUCCESS)
+            ssp_err = g_flash0.p_api->write(g_flash0.p_ctrl, (uint32_t)p_src, address,
+                                            (size + DATA_FLASH_PROGRAMMING_UNIT - 1) & (uint32_t)(~(DATA_FLASH_PROGRAMMING_UNIT - 1)));
+        g_flash0.p_api->close(g_flash0.p_ctrl);
+    }
+    tx_mutex_put(&data_flash_mutex);
+    return ssp_err;
+}
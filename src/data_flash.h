@@ -0,0 +1,45 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : data_flash.h
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Data-flash layout and access helpers shared by the threads.
+ ******************************************************************************/
+
+#ifndef DATA_FLASH_H_
+#define DATA_FLASH_H_
+
+#include "hal_data.h"
+
+#define DATA_FLASH_BLOCK_SIZE 64
+#define DATA_FLASH_PROGRAMMING_UNIT 4
+
+// each record starts on its own erase block
+#define DATA_FLASH_PROVISION_ADDRESS    0x40100000
+#define DATA_FLASH_CALIBRATION_ADDRESS  0x40100400
+#define DATA_FLASH_NETWORK_ADDRESS      0x40100800
+
+void data_flash_init(void);
+ssp_err_t data_flash_read(uint32_t address, void * p_dest, uint32_t size);
+ssp_err_t data_flash_write(uint32_t address, const void * p_src, uint32_t size);
+
+#endif /* DATA_FLASH_H_ */
@@ -0,0 +1,135 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : deadband.c
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Suppresses telemetry fields which did not change since they
+ *                were last published. A producer owns one deadband_t per
+ *                periodic event, with one deadband_field_t per filtered
+ *                field. Each event starts with deadband_begin; a field is
+ *                then published only if it moved from its last published
+ *                value by more than
+ *                    max(absolute, relative * |last|)
+ *                Every snapshot_windows events, and whenever the filter is
+ *                reset, all fields are published so a receiver which
+ *                missed earlier events recovers the full state.
+ ******************************************************************************/
+
+#include "deadband.h"
+
+#include <math.h>
+
+/******************************************************************************
+* Function Name: deadband_init
+* Description  : Attaches the field table to the filter and resets it. The
+*                absolute threshold of each field must already be set.
+* Arguments    : p_deadband –
+*                    filter to initialize.
+*                p_fields -
+*                    one entry per filtered field.
+*                count -
+*                    number of entries in p_fields.
+******************************************************************************/
+void deadband_init(deadband_t * p_deadband, deadband_field_t * p_fields, uint16_t count) {
+    p_deadband->p_fields = p_fields;
+    p_deadband->count = count;
+    p_deadband->relative = 0;
+    deadband_reset(p_deadband);
+}
+
+/******************************************************************************
+* Function Name: deadband_reset
+* Description  : Forgets the published values, so the next event is a full
+*                snapshot.
+* Arguments    : p_deadband –
+*                    filter to reset.
+******************************************************************************/
+void deadband_reset(deadband_t * p_deadband) {
+    for (uint16_t i = 0; i < p_deadband->count; i++)
+        p_deadband->p_fields[i].valid = false;
+    p_deadband->windows = 0;
+    p_deadband->snapshot = true;
+}
+
+/******************************************************************************
+* Function Name: deadband_begin
+* Description  : Starts a new event.
+* Arguments    : p_deadband –
+*                    filter of the event.
+*                relative_pct -
+*                    relative threshold (%). 0 turns the filter off, so
+*                    every event is a full snapshot.
+*                snapshot_windows -
+*                    a full snapshot is sent every this many events.
+* Return Value : true if this event is a full snapshot.
+******************************************************************************/
+bool deadband_begin(deadband_t * p_deadband, int relative_pct, int snapshot_windows) {
+    p_deadband->relative = (float)relative_pct / 100;
+    if (relative_pct <= 0 || p_deadband->windows == 0 || p_deadband->windows >= snapshot_windows) {
+        p_deadband->windows = 0;
+        p_deadband->snapshot = true;
+    } else {
+        p_deadband->snapshot = false;
+    }
+    p_deadband->windows++;
+    return p_deadband->snapshot;
+}
+
+/******************************************************************************
+* Function Name: deadband_check
+* Description  : Decides whether a field is published in the current event,
+*                and if so records the value as published.
+* Arguments    : p_deadband –
+*                    filter of the event.
+*                field -
+*                    index of the field in the field table.
+*                value -
+*                    current value of the field.
+* Return Value : true if the field is to be published.
+******************************************************************************/
+bool deadband_check(deadband_t * p_deadband, uint16_t field, float value) {
+    deadband_field_t * p_field = &p_deadband->p_fields[field];
+
+    if (!p_deadband->snapshot && p_field->valid) {
+        float delta = fabsf(value - p_field->last);
+        float band = p_deadband->relative * fabsf(p_field->last);
+        if (band < p_field->absolute)
+            band = p_field->absolute;
+        // a non-finite value compares false and is always published
+        if (delta <= band)
+            return false;
+    }
+    p_field->last = value;
+    p_field->valid = true;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: deadband_key_float
+* Description  : json_key_float for a filtered field: writes the member only
+*                if deadband_check passes it.
+******************************************************************************/
+void deadband_key_float(json_writer_t * p_writer, deadband_t * p_deadband, uint16_t field,
+                        const char * key, float value, int decimals) {
+    if (deadband_check(p_deadband, field, value))
+        json_key_float(p_writer, key, value, decimals);
+}
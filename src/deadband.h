@@ -0,0 +1,58 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : deadband.h
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Per-field deadband filter for periodic telemetry events.
+ ******************************************************************************/
+
+#ifndef DEADBAND_H_
+#define DEADBAND_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "json_writer.h"
+
+typedef struct deadband_field
+{
+    float   absolute;   ///< smallest change always published.
+    float   last;       ///< last published value.
+    bool    valid;      ///< last holds a published value.
+} deadband_field_t;
+
+typedef struct deadband
+{
+    deadband_field_t *  p_fields;
+    uint16_t            count;
+    uint16_t            windows;    ///< windows since the last full snapshot.
+    float               relative;   ///< change relative to the last value, 0 publishes every field.
+    bool                snapshot;   ///< the current window publishes every field.
+} deadband_t;
+
+void deadband_init(deadband_t * p_deadband, deadband_field_t * p_fields, uint16_t count);
+void deadband_reset(deadband_t * p_deadband);
+bool deadband_begin(deadband_t * p_deadband, int relative_pct, int snapshot_windows);
+bool deadband_check(deadband_t * p_deadband, uint16_t field, float value);
+void deadband_key_float(json_writer_t * p_writer, deadband_t * p_deadband, uint16_t field,
+                        const char * key, float value, int decimals);
+
+#endif /* DEADBAND_H_ */
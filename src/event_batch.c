@@ -0,0 +1,382 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : event_batch.c
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Coalesces outbound events so that several of them share a
+ *                single MQTT PUBLISH. Producers copy their JSON into the
+ *                pending buffer of its priority class and return at once;
+ *                net_thread runs the flush loop once connected.
+ *                Interactive and reply events are flushed at once. Bulk
+ *                events are flushed when they reach event_batch_flush_size
+ *                bytes or EVENT_BATCH_MAX_EVENTS events, or when the oldest
+ *                one is event_batch_max_age old. Each pass of the flush loop
+ *                publishes one payload, always from the highest class that
+ *                is due, so a queued bulk batch or stored backlog never
+ *                holds up a touch event or a command reply by more than one
+ *                publish.
+ *                Several events are sent as
+ *                    {"batch":[{"age_ms":<n>,"event":{...}},...]}
+ *                where age_ms is the time the event waited on the device,
+ *                so the receiver can recover when it was observed (the
+ *                board has no wall clock). A single event is sent
+ *                unchanged.
+ *                Payloads which cannot be published are appended to the
+ *                persistent event store in QSPI flash. While the store
+ *                holds anything, new bulk payloads go behind them so order
+ *                is kept, and one stored payload is replayed every
+ *                EVENT_BATCH_REPLAY_PERIOD ticks. A replayed payload keeps
+ *                its age_ms from the original flush.
+ *                Every publish result is passed to the connection manager,
+ *                so it notices when the agent loses the broker.
+ ******************************************************************************/
+
+#include <app.h>
+#include "tx_api.h"
+#include "event_batch.h"
+#include "json_writer.h"
+#include "event_store.h"
+#include "connection.h"
+#include <m1_agent.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#define EVENT_BATCH_FLUSH_FLAG  0x01
+
+// at most one stored payload per period (ticks) is replayed after an outage
+#define EVENT_BATCH_REPLAY_PERIOD   20
+
+// {"age_ms":<10 digits>,"event":} plus the separator
+#define EVENT_BATCH_EVENT_OVERHEAD  32
+
+// event_batch_wait result for an empty queue
+#define EVENT_BATCH_NOT_DUE     0xFFFFFFFFUL
+
+typedef struct event_batch_entry
+{
+    uint16_t    offset;
+    uint16_t    length;
+    ULONG       tick;
+} event_batch_entry_t;
+
+typedef struct event_batch_queue
+{
+    const char *        name;
+    char *              p_pending;
+    uint16_t            size;
+    uint16_t            pending_size;
+    event_batch_entry_t entries[EVENT_BATCH_MAX_EVENTS];
+    uint16_t            entry_cnt;
+    bool                full;               ///< an event was dropped, flush without waiting.
+    // statistics since the last statistics event
+    uint32_t            stat_events;
+    uint32_t            stat_latency_tot;
+    uint32_t            stat_latency_max;
+} event_batch_queue_t;
+
+int event_batch_max_age = 500;
+int event_batch_flush_size = 1024;
+
+static TX_MUTEX event_batch_mutex;
+static TX_EVENT_FLAGS_GROUP event_batch_flags;
+
+static char interactive_pending[EVENT_BATCH_INTERACTIVE_SIZE];
+static char reply_pending[EVENT_BATCH_REPLY_SIZE];
+static char bulk_pending[EVENT_BATCH_PENDING_SIZE];
+
+static event_batch_queue_t queues[EVENT_PRIORITY_COUNT] =
+{
+    [EVENT_PRIORITY_INTERACTIVE] = { .name = "interactive", .p_pending = interactive_pending, .size = sizeof(interactive_pending) },
+    [EVENT_PRIORITY_REPLY]       = { .name = "reply",       .p_pending = reply_pending,       .size = sizeof(reply_pending) },
+    [EVENT_PRIORITY_BULK]        = { .name = "bulk",        .p_pending = bulk_pending,        .size = sizeof(bulk_pending) },
+};
+
+static char payload[EVENT_BATCH_PENDING_SIZE + EVENT_BATCH_MAX_EVENTS * EVENT_BATCH_EVENT_OVERHEAD + 16];
+
+// statistics since the last statistics event
+static uint32_t stat_batches = 0;
+static uint32_t stat_events = 0;
+static uint32_t stat_bytes = 0;
+static uint32_t stat_dropped = 0;
+static uint32_t stat_failed = 0;
+static uint32_t stat_stored = 0;
+static uint32_t stat_replayed = 0;
+
+/******************************************************************************
+* Function Name: event_batch_init
+* Description  : Creates the batching mutex and flush event flags. Must be
+*                called once, before any thread publishes an event.
+******************************************************************************/
+void event_batch_init(void) {
+    UINT status = tx_mutex_create(&event_batch_mutex, "Event Batch Mutex", TX_NO_INHERIT);
+    APP_ERR_TRAP(status);
+    status = tx_event_flags_create(&event_batch_flags, "Event Batch Flags");
+    APP_ERR_TRAP(status);
+    // without the store, payloads which cannot be published are lost
+    if (store_flash_qspi_open() == 0)
+        event_store_init(&store_flash_qspi);
+}
+
+/******************************************************************************
+* Function Name: event_batch_publish
+* Description  : Queues an event for the next flush of its class. The JSON is
+*                copied, so the caller may reuse its buffer. Never waits for
+*                the network; the mutex is only held for the copy.
+* Arguments    : json –
+*                    serialized JSON object.
+*                priority -
+*                    class the event is queued and flushed in.
+* Return Value : 0 on success, -1 if the event was dropped because the
+*                pending buffer of its class is full.
+******************************************************************************/
+int event_batch_publish(const char * json, event_priority_t priority) {
+    event_batch_queue_t * p_queue = &queues[priority];
+    size_t length = strlen(json);
+    bool flush;
+
+    tx_mutex_get(&event_batch_mutex, TX_WAIT_FOREVER);
+    if (p_queue->entry_cnt == EVENT_BATCH_MAX_EVENTS || p_queue->pending_size + length > p_queue->size) {
+        p_queue->full = true;
+        stat_dropped++;
+        tx_mutex_put(&event_batch_mutex);
+        tx_event_flags_set(&event_batch_flags, EVENT_BATCH_FLUSH_FLAG, TX_OR);
+        return -1;
+    }
+    memcpy(&p_queue->p_pending[p_queue->pending_size], json, length);
+    p_queue->entries[p_queue->entry_cnt].offset = p_queue->pending_size;
+    p_queue->entries[p_queue->entry_cnt].length = (uint16_t)length;
+    p_queue->entries[p_queue->entry_cnt].tick = tx_time_get();
+    p_queue->entry_cnt++;
+    p_queue->pending_size = (uint16_t)(p_queue->pending_size + length);
+    flush = priority != EVENT_PRIORITY_BULK || p_queue->entry_cnt == EVENT_BATCH_MAX_EVENTS
+            || p_queue->pending_size >= event_batch_flush_size;
+    tx_mutex_put(&event_batch_mutex);
+
+    if (flush)
+        tx_event_flags_set(&event_batch_flags, EVENT_BATCH_FLUSH_FLAG, TX_OR);
+    return 0;
+}
+
+/******************************************************************************
+* Function Name: event_batch_wait
+* Description  : Works out when a queue is due for a flush. Must be called
+*                with the mutex held.
+* Arguments    : priority –
+*                    class of the queue.
+*                now -
+*                    current tick.
+* Return Value : ticks until the queue is due, 0 if it is due now, or
+*                EVENT_BATCH_NOT_DUE if it is empty.
+******************************************************************************/
+static ULONG event_batch_wait(event_priority_t priority, ULONG now) {
+    event_batch_queue_t * p_queue = &queues[priority];
+    ULONG age, max_age;
+
+    if (p_queue->entry_cnt == 0)
+        return EVENT_BATCH_NOT_DUE;
+    if (priority != EVENT_PRIORITY_BULK || p_queue->full || p_queue->entry_cnt == EVENT_BATCH_MAX_EVENTS
+            || p_queue->pending_size >= event_batch_flush_size)
+        return 0;
+    age = now - p_queue->entries[0].tick;
+    max_age = (ULONG)event_batch_max_age / 10;
+    return (age >= max_age) ? 0 : max_age - age;
+}
+
+/******************************************************************************
+* Function Name: event_batch_flush
+* Description  : Moves the pending events of one class into the payload
+*                buffer and publishes them. The mutex is released before
+*                publishing, so producers are not held up by the network.
+* Arguments    : priority –
+*                    class to flush.
+******************************************************************************/
+static void event_batch_flush(event_priority_t priority) {
+    event_batch_queue_t * p_queue = &queues[priority];
+    ULONG now = tx_time_get();
+    size_t size = 0;
+    uint16_t cnt;
+    int status;
+
+    tx_mutex_get(&event_batch_mutex, TX_WAIT_FOREVER);
+    cnt = p_queue->entry_cnt;
+    if (cnt == 1) {
+        memcpy(payload, p_queue->p_pending, p_queue->entries[0].length);
+        size = p_queue->entries[0].length;
+    } else if (cnt > 1) {
+        size = (size_t)sprintf(payload, "{\"batch\":[");
+        for (uint16_t i = 0; i < cnt; i++) {
+            size += (size_t)sprintf(&payload[size], "%s{\"age_ms\":%lu,\"event\":",
+                                    i ? "," : "", (now - p_queue->entries[i].tick) * 10);
+            memcpy(&payload[size], &p_queue->p_pending[p_queue->entries[i].offset], p_queue->entries[i].length);
+            size += p_queue->entries[i].length;
+            payload[size++] = '}';
+        }
+        payload[size++] = ']';
+        payload[size++] = '}';
+    }
+    payload[size] = '\0';
+    for (uint16_t i = 0; i < cnt; i++) {
+        uint32_t latency = (uint32_t)(now - p_queue->entries[i].tick) * 10;
+        p_queue->stat_latency_tot += latency;
+        if (latency > p_queue->stat_latency_max)
+            p_queue->stat_latency_max = latency;
+    }
+    p_queue->stat_events += cnt;
+    p_queue->entry_cnt = 0;
+    p_queue->pending_size = 0;
+    p_queue->full = false;
+    tx_mutex_put(&event_batch_mutex);
+
+    if (cnt == 0)
+        return;
+    stat_batches++;
+    stat_events += cnt;
+    stat_bytes += (uint32_t)size;
+    // only bulk payloads wait behind the stored backlog
+    if (priority == EVENT_PRIORITY_BULK && event_store_pending()) {
+        status = M1_ERROR_UNABLE_TO_PUBLISH;
+    } else {
+        status = m1_publish_event(payload, NULL);
+        connection_publish_status(status);
+    }
+    if (status != M1_SUCCESS) {
+        if (event_store_append(payload, (uint16_t)size))
+            stat_failed++;
+        else
+            stat_stored++;
+    }
+}
+
+/******************************************************************************
+* Function Name: event_batch_replay
+* Description  : Publishes the oldest payload of the event store, and
+*                removes it from the store once published.
+******************************************************************************/
+static void event_batch_replay(void) {
+    int length = event_store_peek(payload, sizeof(payload) - 1);
+    int status;
+
+    if (length <= 0)
+        return;
+    payload[length] = '\0';
+    status = m1_publish_event(payload, NULL);
+    connection_publish_status(status);
+    if (status == M1_SUCCESS) {
+        event_store_pop();
+        stat_replayed++;
+    }
+}
+
+/******************************************************************************
+* Function Name: event_batch_stats
+* Description  : Queues the batching statistics event and starts a new
+*                statistics period. Latency is reported per class, from
+*                the event being queued to its flush.
+******************************************************************************/
+static void event_batch_stats(void) {
+    char statsbuf[512];
+    json_writer_t writer;
+
+    json_begin(&writer, statsbuf, sizeof(statsbuf));
+    json_key_object(&writer, "batch_stats");
+    json_key_uint(&writer, "batches", stat_batches);
+    json_key_uint(&writer, "events", stat_events);
+    json_key_uint(&writer, "avg_events", stat_batches ? stat_events / stat_batches : 0);
+    json_key_uint(&writer, "avg_bytes", stat_batches ? stat_bytes / stat_batches : 0);
+    tx_mutex_get(&event_batch_mutex, TX_WAIT_FOREVER);
+    for (int i = 0; i < EVENT_PRIORITY_COUNT; i++) {
+        event_batch_queue_t * p_queue = &queues[i];
+        json_key_object(&writer, p_queue->name);
+        json_key_uint(&writer, "events", p_queue->stat_events);
+        json_key_uint(&writer, "avg_latency_ms", p_queue->stat_events ? p_queue->stat_latency_tot / p_queue->stat_events : 0);
+        json_key_uint(&writer, "max_latency_ms", p_queue->stat_latency_max);
+        json_end_object(&writer);
+        p_queue->stat_events = 0;
+        p_queue->stat_latency_tot = 0;
+        p_queue->stat_latency_max = 0;
+    }
+    tx_mutex_put(&event_batch_mutex);
+    json_key_uint(&writer, "dropped", stat_dropped);
+    json_key_uint(&writer, "failed", stat_failed);
+    json_key_uint(&writer, "stored", stat_stored);
+    json_key_uint(&writer, "replayed", stat_replayed);
+    json_key_uint(&writer, "backlog", event_store_pending());
+    json_end_object(&writer);
+    stat_batches = 0;
+    stat_events = 0;
+    stat_bytes = 0;
+    stat_dropped = 0;
+    stat_failed = 0;
+    stat_stored = 0;
+    stat_replayed = 0;
+    if (json_end(&writer) > 0)
+        event_batch_publish(statsbuf, EVENT_PRIORITY_BULK);
+}
+
+/******************************************************************************
+* Function Name: event_batch_run
+* Description  : Flush loop, run by net_thread once the cloud connection is
+*                up. Each pass publishes at most one payload: the highest
+*                class which is due, else a stored payload if one is due
+*                for replay. When nothing is due it sleeps until a producer
+*                asks for a flush, the oldest bulk event reaches
+*                event_batch_max_age, a replay or the statistics are due.
+*                Never returns.
+******************************************************************************/
+void event_batch_run(void) {
+    ULONG actual_flags;
+    ULONG stats_tick = tx_time_get() + EVENT_BATCH_STATS_PERIOD;
+    ULONG replay_tick = tx_time_get();
+
+    while (1) {
+        ULONG now = tx_time_get();
+        ULONG wait;
+        int next = -1;
+
+        if (now - stats_tick < 0x80000000UL) {
+            stats_tick = now + EVENT_BATCH_STATS_PERIOD;
+            event_batch_stats();
+        }
+        wait = stats_tick - now;
+        tx_mutex_get(&event_batch_mutex, TX_WAIT_FOREVER);
+        for (int i = 0; i < EVENT_PRIORITY_COUNT; i++) {
+            ULONG due = event_batch_wait((event_priority_t)i, now);
+            if (due == 0 && next < 0)
+                next = i;
+            if (due < wait)
+                wait = due;
+        }
+        tx_mutex_put(&event_batch_mutex);
+
+        if (next >= 0) {
+            event_batch_flush((event_priority_t)next);
+        } else if (event_store_pending() && now - replay_tick < 0x80000000UL) {
+            replay_tick = now + EVENT_BATCH_REPLAY_PERIOD;
+            event_batch_replay();
+        } else {
+            if (event_store_pending() && replay_tick - now < wait)
+                wait = replay_tick - now;
+            tx_event_flags_get(&event_batch_flags, EVENT_BATCH_FLUSH_FLAG, TX_OR_CLEAR, &actual_flags, wait);
+        }
+    }
+}
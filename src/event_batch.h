@@ -0,0 +1,57 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : event_batch.h
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Outbound event batching in front of m1_publish_event.
+ ******************************************************************************/
+
+#ifndef EVENT_BATCH_H_
+#define EVENT_BATCH_H_
+
+// bytes of event JSON that can wait for a flush, per class
+#define EVENT_BATCH_INTERACTIVE_SIZE    512
+#define EVENT_BATCH_REPLY_SIZE          1024
+#define EVENT_BATCH_PENDING_SIZE        1536
+// events that can wait for a flush, per class
+#define EVENT_BATCH_MAX_EVENTS          16
+// period of the batching statistics event (ticks)
+#define EVENT_BATCH_STATS_PERIOD        (5 * 60 * 100)
+
+/** Outbound priority classes, highest first. Queued events of a higher class
+ *  are always published before those of a lower one. */
+typedef enum e_event_priority
+{
+    EVENT_PRIORITY_INTERACTIVE,     ///< user-visible interactions and alerts, flushed at once.
+    EVENT_PRIORITY_REPLY,           ///< replies to cloud commands and settings, flushed at once.
+    EVENT_PRIORITY_BULK,            ///< telemetry, batched up to event_batch_max_age.
+    EVENT_PRIORITY_COUNT
+} event_priority_t;
+
+extern int event_batch_max_age;
+extern int event_batch_flush_size;
+
+void event_batch_init(void);
+int event_batch_publish(const char * json, event_priority_t priority);
+void event_batch_run(void);
+
+#endif /* EVENT_BATCH_H_ */
@@ -0,0 +1,424 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : event_store.c
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Log-structured FIFO of outbound payloads in NOR flash,
+ *                used to keep events while the cloud is unreachable.
+ *                The region is used as a ring of sectors. Each sector
+ *                starts with a header holding an increasing sequence
+ *                number, followed by records:
+ *                    magic, length, crc32, state, reserved, payload
+ *                A record is programmed payload first and header last, so
+ *                a record with a header is complete. Sending a record only
+ *                clears its state bits, so replay progress costs no erase.
+ *                Sectors are erased strictly in turn, once per pass over
+ *                the ring, which bounds wear; when the ring is full the
+ *                oldest sector is erased and its events are counted as
+ *                dropped.
+ *                Nothing is kept in RAM across resets: at init the
+ *                sector with the highest sequence is the write sector, the
+ *                first free byte in it the write pointer, and the first
+ *                unsent record from the oldest sector on the read pointer.
+ *                A write sector with anything but erased flash after its
+ *                last record (a write cut by a reset) is closed and not
+ *                written again until it is recycled.
+ *                Not thread safe; only net_thread uses it.
+ ******************************************************************************/
+
+#include "event_store.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#define STORE_SECTOR_MAGIC  0x45535452
+#define STORE_RECORD_MAGIC  0x5e5e
+#define STORE_RECORD_PENDING 0xffff
+#define STORE_RECORD_SENT   0x0000
+
+typedef struct event_store_sector
+{
+    uint32_t    magic;
+    uint32_t    sequence;
+} event_store_sector_t;
+
+typedef struct event_store_record
+{
+    uint16_t    magic;
+    uint16_t    length;
+    uint32_t    crc;
+    uint16_t    state;
+    uint16_t    reserved;
+} event_store_record_t;
+
+#define STORE_RECORD_SIZE(length) ((uint32_t)sizeof(event_store_record_t) + (((uint32_t)(length) + 3) & ~3u))
+
+static const store_flash_t * p_store = NULL;
+static uint32_t sector_cnt;
+static uint32_t head_sector;
+static uint32_t head_offset;        // next free byte in head_sector, 0 if none is open
+static uint32_t head_sequence;      // 0 if no sector was ever written
+static uint32_t tail_sector;
+static uint32_t tail_offset;        // oldest unsent record, valid while pending
+static uint32_t pending;
+static uint32_t dropped;
+
+/******************************************************************************
+* Function Name: store_crc
+* Description  : CRC-32 (IEEE) of a block, bitwise to avoid a table.
+* Arguments    : p_data –
+*                    data to check.
+*                length -
+*                    number of bytes.
+* Return Value : The CRC.
+******************************************************************************/
+static uint32_t store_crc(const void * p_data, uint32_t length) {
+    const uint8_t * p = p_data;
+    uint32_t crc = 0xffffffff;
+
+    while (length--) {
+        crc ^= *p++;
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ (0xedb88320 & (0u - (crc & 1)));
+    }
+    return ~crc;
+}
+
+/******************************************************************************
+* Function Name: store_program
+* Description  : Programs a block, split at page boundaries.
+* Arguments    : offset –
+*                    region offset.
+*                p_src -
+*                    data to program.
+*                length -
+*                    number of bytes.
+* Return Value : 0 on success, -1 on a flash error.
+******************************************************************************/
+static int store_program(uint32_t offset, const void * p_src, uint32_t length) {
+    const uint8_t * p = p_src;
+
+    while (length) {
+        uint32_t chunk = p_store->page_size - offset % p_store->page_size;
+        if (chunk > length)
+            chunk = length;
+        if (p_store->program(offset, p, chunk))
+            return -1;
+        offset += chunk;
+        p += chunk;
+        length -= chunk;
+    }
+    return 0;
+}
+
+/******************************************************************************
+* Function Name: store_record_read
+* Description  : Reads the record header at a position.
+* Arguments    : sector –
+*                    sector index.
+*                offset -
+*                    offset in the sector.
+*                p_record -
+*                    receives the header.
+* Return Value : true if a record which fits the sector is there.
+******************************************************************************/
+static bool store_record_read(uint32_t sector, uint32_t offset, event_store_record_t * p_record) {
+    if (offset + sizeof(*p_record) > p_store->sector_size)
+        return false;
+    if (p_store->read(sector * p_store->sector_size + offset, p_record, sizeof(*p_record)))
+        return false;
+    return p_record->magic == STORE_RECORD_MAGIC &&
+           offset + STORE_RECORD_SIZE(p_record->length) <= p_store->sector_size;
+}
+
+/******************************************************************************
+* Function Name: store_find_pending
+* Description  : Moves the read pointer to the first unsent record at or
+*                after a position, stopping at the write pointer.
+* Arguments    : sector –
+*                    sector index to start in.
+*                offset -
+*                    offset in the sector to start at.
+* Return Value : true if a record was found.
+******************************************************************************/
+static bool store_find_pending(uint32_t sector, uint32_t offset) {
+    event_store_record_t record;
+
+    while (!(sector == head_sector && offset >= head_offset)) {
+        if (!store_record_read(sector, offset, &record)) {
+            if (sector == head_sector)
+                return false;
+            sector = (sector + 1) % sector_cnt;
+            offset = sizeof(event_store_sector_t);
+            continue;
+        }
+        if (record.state == STORE_RECORD_PENDING) {
+            tail_sector = sector;
+            tail_offset = offset;
+            return true;
+        }
+        offset += STORE_RECORD_SIZE(record.length);
+    }
+    return false;
+}
+
+/******************************************************************************
+* Function Name: store_erased
+* Description  : Checks that a range of a sector is erased.
+* Arguments    : sector –
+*                    sector index.
+*                offset -
+*                    offset in the sector, the range ends with the sector.
+* Return Value : true if every byte reads as 0xff.
+******************************************************************************/
+static bool store_erased(uint32_t sector, uint32_t offset) {
+    uint8_t buf[64];
+
+    while (offset < p_store->sector_size) {
+        uint32_t chunk = p_store->sector_size - offset;
+        if (chunk > sizeof(buf))
+            chunk = sizeof(buf);
+        if (p_store->read(sector * p_store->sector_size + offset, buf, chunk))
+            return false;
+        for (uint32_t i = 0; i < chunk; i++) {
+            if (buf[i] != 0xff)
+                return false;
+        }
+        offset += chunk;
+    }
+    return true;
+}
+
+/******************************************************************************
+* Function Name: store_open_sector
+* Description  : Erases the next sector of the ring and makes it the write
+*                sector. Unsent records in it are dropped.
+* Return Value : 0 on success, -1 on a flash error.
+******************************************************************************/
+static int store_open_sector(void) {
+    uint32_t next = head_sequence ? (head_sector + 1) % sector_cnt : 0;
+    event_store_sector_t header;
+    event_store_record_t record;
+
+    if (pending && tail_sector == next) {
+        // ring full: the oldest sector is recycled
+        uint32_t offset = tail_offset;
+        uint32_t lost = 0;
+        while (store_record_read(next, offset, &record)) {
+            if (record.state == STORE_RECORD_PENDING)
+                lost++;
+            offset += STORE_RECORD_SIZE(record.length);
+        }
+        lost = (lost > pending) ? pending : lost;
+        pending -= lost;
+        dropped += lost;
+        if (pending && !store_find_pending((next + 1) % sector_cnt, sizeof(event_store_sector_t)))
+            pending = 0;
+    }
+    // closed until the header is written, so a failure below is not retried in place
+    head_sector = next;
+    head_offset = p_store->sector_size;
+    if (p_store->erase(next * p_store->sector_size))
+        return -1;
+    header.magic = STORE_SECTOR_MAGIC;
+    header.sequence = ++head_sequence;
+    if (store_program(next * p_store->sector_size, &header, sizeof(header)))
+        return -1;
+    head_offset = sizeof(header);
+    return 0;
+}
+
+/******************************************************************************
+* Function Name: event_store_init
+* Description  : Attaches the store to a flash region and recovers the read
+*                and write pointers from its contents.
+* Arguments    : p_flash –
+*                    flash operations for the region.
+* Return Value : 0 on success, -1 if the region cannot be used.
+******************************************************************************/
+int event_store_init(const store_flash_t * p_flash) {
+    event_store_sector_t header;
+    event_store_record_t record;
+    uint32_t oldest_sector = 0;
+    uint32_t oldest_sequence = 0;
+    uint32_t offset;
+
+    p_store = p_flash;
+    sector_cnt = p_flash->size / p_flash->sector_size;
+    head_sector = 0;
+    head_offset = 0;
+    head_sequence = 0;
+    pending = 0;
+    dropped = 0;
+    if (sector_cnt < 2) {
+        p_store = NULL;
+        return -1;
+    }
+
+    for (uint32_t sector = 0; sector < sector_cnt; sector++) {
+        if (p_store->read(sector * p_store->sector_size, &header, sizeof(header))) {
+            p_store = NULL;
+            return -1;
+        }
+        if (header.magic != STORE_SECTOR_MAGIC || header.sequence == 0xffffffff)
+            continue;
+        if (head_sequence == 0 || header.sequence > head_sequence) {
+            head_sequence = header.sequence;
+            head_sector = sector;
+        }
+        if (oldest_sequence == 0 || header.sequence < oldest_sequence) {
+            oldest_sequence = header.sequence;
+            oldest_sector = sector;
+        }
+    }
+    if (head_sequence == 0)
+        return 0;
+
+    // the write pointer follows the last record of the write sector
+    offset = sizeof(header);
+    while (store_record_read(head_sector, offset, &record))
+        offset += STORE_RECORD_SIZE(record.length);
+    head_offset = store_erased(head_sector, offset) ? offset : p_store->sector_size;
+
+    // count the unsent records from the oldest sector on
+    uint32_t first_sector = 0;
+    uint32_t first_offset = 0;
+    uint32_t sector = oldest_sector;
+    offset = sizeof(header);
+    while (store_find_pending(sector, offset)) {
+        if (pending++ == 0) {
+            first_sector = tail_sector;
+            first_offset = tail_offset;
+        }
+        sector = tail_sector;
+        store_record_read(tail_sector, tail_offset, &record);
+        offset = tail_offset + STORE_RECORD_SIZE(record.length);
+    }
+    tail_sector = first_sector;
+    tail_offset = first_offset;
+    return 0;
+}
+
+/******************************************************************************
+* Function Name: event_store_append
+* Description  : Appends a payload after the newest record.
+* Arguments    : p_event –
+*                    payload.
+*                length -
+*                    payload length in bytes.
+* Return Value : 0 on success, -1 if the payload was not stored.
+******************************************************************************/
+int event_store_append(const void * p_event, uint16_t length) {
+    event_store_record_t record;
+    uint32_t size = STORE_RECORD_SIZE(length);
+
+    if (p_store == NULL || size > p_store->sector_size - sizeof(event_store_sector_t))
+        return -1;
+    if (head_offset == 0 || head_offset + size > p_store->sector_size) {
+        if (store_open_sector())
+            return -1;
+    }
+
+    uint32_t base = head_sector * p_store->sector_size + head_offset;
+    record.magic = STORE_RECORD_MAGIC;
+    record.length = length;
+    record.crc = store_crc(p_event, length);
+    record.state = STORE_RECORD_PENDING;
+    record.reserved = 0xffff;
+    if (store_program(base + sizeof(record), p_event, length) ||
+            store_program(base, &record, sizeof(record))) {
+        head_offset = p_store->sector_size;
+        return -1;
+    }
+    if (pending++ == 0) {
+        tail_sector = head_sector;
+        tail_offset = head_offset;
+    }
+    head_offset += size;
+    return 0;
+}
+
+/******************************************************************************
+* Function Name: event_store_peek
+* Description  : Copies out the oldest unsent payload. Records which fail
+*                their CRC or do not fit the buffer are skipped and counted
+*                as dropped.
+* Arguments    : p_buf –
+*                    buffer for the payload.
+*                size -
+*                    size of the buffer.
+* Return Value : Payload length, 0 if nothing is pending, -1 on a flash error.
+******************************************************************************/
+int event_store_peek(void * p_buf, uint16_t size) {
+    event_store_record_t record;
+
+    while (pending) {
+        uint32_t base = tail_sector * p_store->sector_size + tail_offset;
+        if (p_store->read(base, &record, sizeof(record)))
+            return -1;
+        if (record.length <= size) {
+            if (p_store->read(base + sizeof(record), p_buf, record.length))
+                return -1;
+            if (store_crc(p_buf, record.length) == record.crc)
+                return record.length;
+        }
+        event_store_pop();
+        dropped++;
+    }
+    return 0;
+}
+
+/******************************************************************************
+* Function Name: event_store_pop
+* Description  : Marks the oldest unsent payload as sent.
+******************************************************************************/
+void event_store_pop(void) {
+    event_store_record_t record;
+    uint16_t state = STORE_RECORD_SENT;
+
+    if (!pending)
+        return;
+    uint32_t base = tail_sector * p_store->sector_size + tail_offset;
+    store_program(base + offsetof(event_store_record_t, state), &state, sizeof(state));
+    pending--;
+    if (pending && (!store_record_read(tail_sector, tail_offset, &record) ||
+                    !store_find_pending(tail_sector, tail_offset + STORE_RECORD_SIZE(record.length))))
+        pending = 0;
+}
+
+/******************************************************************************
+* Function Name: event_store_pending
+* Return Value : Number of payloads waiting to be sent.
+******************************************************************************/
+uint32_t event_store_pending(void) {
+    return pending;
+}
+
+/******************************************************************************
+* Function Name: event_store_dropped
+* Return Value : Number of payloads lost to a full ring or corruption since
+*                init.
+******************************************************************************/
+uint32_t event_store_dropped(void) {
+    return dropped;
+}
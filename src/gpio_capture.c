@@ -0,0 +1,260 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : gpio_capture.c
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Records edges on the cloud driver GPIO pins from their
+ *                external interrupts, so pin changes no longer need fast
+ *                polling with cloud driver command 4. Capture is set with
+ *                    G<pin>;<mode>;<debounce_us>
+ *                where <pin> is the cloud driver pin number and <mode> is
+ *                GPIO_CAPTURE_OFF, _RISING, _FALLING or _BOTH. Only input
+ *                pins with an IRQ function are supported, which leaves
+ *                4 (P03_04, IRQ9): P02_05 has IRQ1 but drives the Pmod D
+ *                slave select, and P03_13 to P03_15 have no IRQ. The
+ *                interrupt stamps each edge with timestamp_us and puts it
+ *                in a ring; edges closer than <debounce_us> to the
+ *                last kept edge of the pin, and repeated levels, are
+ *                dropped as bounces. The sensor thread publishes the ring
+ *                as bulk events of up to GPIO_CAPTURE_BATCH edges
+ *                    {"gpio_edges":{"t0_ms":<n>,"edges":"4+0,4-1520,...",
+ *                     "dropped":<n>,"bounces":<n>}}
+ *                where each edge is <pin><+|-><us since the first edge>,
+ *                once a batch is full or its first edge is
+ *                GPIO_CAPTURE_AGE old.
+ ******************************************************************************/
+
+#include <app.h>
+#include "tx_api.h"
+#include "sensor_thread.h"
+#include "gpio_capture.h"
+#include "event_batch.h"
+#include "json_writer.h"
+#include "timestamp.h"
+#include <m1_cloud_driver.h>
+
+#include <stdio.h>
+
+typedef struct gpio_capture_pin
+{
+    uint32_t                        number;     ///< cloud driver pin number.
+    ioport_port_pin_t               pin;
+    const external_irq_instance_t * p_irq;
+    uint32_t                        channel;    ///< IRQ channel of p_irq.
+    volatile uint32_t               mode;
+    uint32_t                        debounce;   ///< us.
+    uint32_t                        last;       ///< time stamp of the last kept edge.
+    ioport_level_t                  level;      ///< of the last kept edge.
+} gpio_capture_pin_t;
+
+typedef struct gpio_capture_edge
+{
+    uint32_t    us;
+    uint8_t     number;
+    uint8_t     rising;
+} gpio_capture_edge_t;
+
+static gpio_capture_pin_t pins[] =
+{
+    { 4, IOPORT_PORT_03_PIN_04, &g_gpio_irq9, 9, GPIO_CAPTURE_OFF, 0, 0, IOPORT_LEVEL_LOW },
+};
+
+// written by the interrupt at head, read by sensor_thread at tail
+static gpio_capture_edge_t ring[GPIO_CAPTURE_RING];
+static volatile uint32_t head = 0;
+static volatile uint32_t tail = 0;
+
+// counted by the interrupt since start, events carry the difference
+static volatile uint32_t dropped = 0;
+static volatile uint32_t bounces = 0;
+static uint32_t dropped_reported = 0;
+static uint32_t bounces_reported = 0;
+
+// only used by sensor_thread, so kept off its stack
+static char edges[GPIO_CAPTURE_BATCH * 16];
+static char event[sizeof(edges) + 96];
+
+/******************************************************************************
+* Function Name: gpio_capture_init
+* Description  : Opens the pin interrupts, left disabled until capture is
+*                set.
+******************************************************************************/
+void gpio_capture_init(void) {
+    for (unsigned int i = 0; i < sizeof(pins) / sizeof(pins[0]); i++) {
+        ssp_err_t err = pins[i].p_irq->p_api->open(pins[i].p_irq->p_ctrl, pins[i].p_irq->p_cfg);
+        APP_ERR_TRAP(err);
+    }
+}
+
+/******************************************************************************
+* Function Name: gpio_capture_callback
+* Description  : Pin interrupt, records the edge unless it is a bounce or
+*                the ring is full.
+* Arguments    : p_args –
+*                    interrupt channel.
+******************************************************************************/
+void gpio_capture_callback(external_irq_callback_args_t * p_args) {
+    uint32_t now = timestamp_us();
+    gpio_capture_pin_t * p_pin = NULL;
+    ioport_level_t level;
+
+    for (unsigned int i = 0; i < sizeof(pins) / sizeof(pins[0]); i++) {
+        if (pins[i].channel == p_args->channel)
+            p_pin = &pins[i];
+    }
+    if (p_pin == NULL || p_pin->mode == GPIO_CAPTURE_OFF)
+        return;
+
+    // a single-edge trigger tells the direction even if the pin bounced back
+    if (p_pin->mode == GPIO_CAPTURE_BOTH)
+        g_ioport.p_api->pinRead(p_pin->pin, &level);
+    else
+        level = (p_pin->mode == GPIO_CAPTURE_RISING) ? IOPORT_LEVEL_HIGH : IOPORT_LEVEL_LOW;
+    if ((p_pin->mode == GPIO_CAPTURE_BOTH && level == p_pin->level) || now - p_pin->last < p_pin->debounce) {
+        bounces++;
+        return;
+    }
+    p_pin->last = now;
+    p_pin->level = level;
+
+    if (head - tail >= GPIO_CAPTURE_RING) {
+        dropped++;
+        return;
+    }
+    gpio_capture_edge_t * p_edge = &ring[head % GPIO_CAPTURE_RING];
+    p_edge->us = now;
+    p_edge->number = (uint8_t)p_pin->number;
+    p_edge->rising = (level == IOPORT_LEVEL_HIGH);
+    head++;
+}
+
+/******************************************************************************
+* Function Name: gpio_capture_register
+* Description  : Sets the capture mode of a pin. A malformed message or a
+*                pin without an IRQ input is ignored.
+* Arguments    : p_message –
+*                    null-terminated capture message, starting with
+*                    GPIO_CAPTURE_MARKER.
+* Return Value : M1_SUCCESS_NO_DATA, M1_ERROR_BAD_HEADER for a malformed
+*                message or M1_ERROR_PORT for a pin which cannot be
+*                captured.
+******************************************************************************/
+int gpio_capture_register(const char * p_message) {
+    static const external_irq_trigger_t triggers[] =
+        { EXTERNAL_IRQ_TRIG_RISING, EXTERNAL_IRQ_TRIG_RISING, EXTERNAL_IRQ_TRIG_FALLING, EXTERNAL_IRQ_TRIG_BOTH_EDGE };
+    unsigned int number;
+    unsigned int mode;
+    unsigned int debounce_us;
+    gpio_capture_pin_t * p_pin = NULL;
+
+    if (sscanf(&p_message[1], "%u;%u;%u", &number, &mode, &debounce_us) != 3 || mode > GPIO_CAPTURE_BOTH)
+        return M1_ERROR_BAD_HEADER;
+    for (unsigned int i = 0; i < sizeof(pins) / sizeof(pins[0]); i++) {
+        if (pins[i].number == number)
+            p_pin = &pins[i];
+    }
+    if (p_pin == NULL)
+        return M1_ERROR_PORT;
+
+    const external_irq_instance_t * p_irq = p_pin->p_irq;
+    p_irq->p_api->disable(p_irq->p_ctrl);
+    p_pin->mode = mode;
+    if (mode == GPIO_CAPTURE_OFF)
+        return M1_SUCCESS_NO_DATA;
+    p_pin->debounce = debounce_us;
+    p_pin->last = timestamp_us() - p_pin->debounce;
+    g_ioport.p_api->pinRead(p_pin->pin, &p_pin->level);
+    p_irq->p_api->triggerSet(p_irq->p_ctrl, triggers[mode]);
+    p_irq->p_api->enable(p_irq->p_ctrl);
+    return M1_SUCCESS_NO_DATA;
+}
+
+/******************************************************************************
+* Function Name: gpio_capture_publish
+* Description  : Publishes up to GPIO_CAPTURE_BATCH edges from the ring.
+* Arguments    : count –
+*                    edges in the ring.
+******************************************************************************/
+static void gpio_capture_publish(uint32_t count) {
+    const gpio_capture_edge_t * p_first = &ring[tail % GPIO_CAPTURE_RING];
+    json_writer_t writer;
+    size_t length = 0;
+
+    if (count > GPIO_CAPTURE_BATCH)
+        count = GPIO_CAPTURE_BATCH;
+    for (uint32_t i = 0; i < count; i++) {
+        const gpio_capture_edge_t * p_edge = &ring[(tail + i) % GPIO_CAPTURE_RING];
+        unsigned long offset_us = p_edge->us - p_first->us;
+
+        length += (size_t)snprintf(&edges[length], sizeof(edges) - length, "%s%u%c%lu", i ? "," : "",
+                                   p_edge->number, p_edge->rising ? '+' : '-', offset_us);
+        if (length >= sizeof(edges))
+            break;
+    }
+
+    uint32_t dropped_now = dropped;
+    uint32_t bounces_now = bounces;
+    json_begin(&writer, event, sizeof(event));
+    json_key_object(&writer, "gpio_edges");
+    json_key_uint(&writer, "t0_ms", p_first->us / 1000);
+    json_key_string(&writer, "edges", edges);
+    json_key_uint(&writer, "dropped", dropped_now - dropped_reported);
+    json_key_uint(&writer, "bounces", bounces_now - bounces_reported);
+    json_end_object(&writer);
+    tail += count;
+    if (json_end(&writer) > 0 && !event_batch_publish(event, EVENT_PRIORITY_BULK)) {
+        dropped_reported = dropped_now;
+        bounces_reported = bounces_now;
+    }
+}
+
+/******************************************************************************
+* Function Name: gpio_capture_run
+* Description  : Publishes the captured edges which are due.
+* Return Value : ticks until the next check, TX_WAIT_FOREVER while no pin
+*                is captured.
+******************************************************************************/
+ULONG gpio_capture_run(void) {
+    uint32_t now = timestamp_us();
+    uint32_t count = head - tail;
+    ULONG age = 0;
+    bool armed = false;
+
+    while (count) {
+        // in ticks, as the wait
+        age = (now - ring[tail % GPIO_CAPTURE_RING].us) / 10000;
+        // stamped after now was read
+        if (age >= 0x80000000UL / 10000)
+            age = 0;
+        if (count < GPIO_CAPTURE_BATCH && age < GPIO_CAPTURE_AGE)
+            return GPIO_CAPTURE_AGE - age;
+        gpio_capture_publish(count);
+        count = head - tail;
+    }
+
+    for (unsigned int i = 0; i < sizeof(pins) / sizeof(pins[0]); i++) {
+        if (pins[i].mode != GPIO_CAPTURE_OFF)
+            armed = true;
+    }
+    // edges arrive without waking the thread, so check back once per age
+    return armed ? GPIO_CAPTURE_AGE : TX_WAIT_FOREVER;
+}
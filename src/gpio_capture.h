@@ -0,0 +1,52 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : gpio_capture.h
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Interrupt-driven edge capture on the cloud driver GPIO pins.
+ ******************************************************************************/
+
+#ifndef GPIO_CAPTURE_H_
+#define GPIO_CAPTURE_H_
+
+#include "tx_api.h"
+
+// first character of a capture message
+#define GPIO_CAPTURE_MARKER     'G'
+// edges held between the interrupt and the sensor thread, a power of 2
+#define GPIO_CAPTURE_RING       64
+// edges published in one event
+#define GPIO_CAPTURE_BATCH      16
+// longest time an edge waits for its batch to fill (ticks)
+#define GPIO_CAPTURE_AGE        100
+
+// gpio_capture modes
+#define GPIO_CAPTURE_OFF        0
+#define GPIO_CAPTURE_RISING     1
+#define GPIO_CAPTURE_FALLING    2
+#define GPIO_CAPTURE_BOTH       3
+
+void gpio_capture_init(void);
+int gpio_capture_register(const char * p_message);
+ULONG gpio_capture_run(void);
+
+#endif /* GPIO_CAPTURE_H_ */
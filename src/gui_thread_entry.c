@@ -31,6 +31,9 @@
 #include <app.h>
 #include "gui_thread.h"
 #include <m1_agent.h>
+#include "event_batch.h"
+#include "json_writer.h"
+#include "boot_timeline.h"
 
 #include <stdio.h>
 #include <stdarg.h>
@@ -83,12 +86,15 @@ void gui_thread_entry(void)
 {
     ssp_err_t err;
     char event[128];
+    json_writer_t writer;
 
+    boot_mark(BOOT_LCD_START);
     g_Blacklight_PWM.p_api->open(g_Blacklight_PWM.p_ctrl, g_Blacklight_PWM.p_cfg);
     g_Blacklight_PWM.p_api->dutyCycleSet(g_Blacklight_PWM.p_ctrl, 100, TIMER_PWM_UNIT_PERCENT, 0);
 
     ConfigureDisplayHardware565rgb();
     PaintScreen((uint8_t *) m1provision);
+    boot_mark(BOOT_LCD_READY);
     // wait up to 10 seconds for user to enter provisioning mode
     // any touch event is considered to mean the user selected provisioning mode
     err = g_sf_message0.p_api->pend(g_sf_message0.p_ctrl, &gui_thread_message_queue, (sf_message_header_t **) &p_message, 1000);
@@ -104,6 +110,7 @@ void gui_thread_entry(void)
         }
     }
 
+    boot_mark(BOOT_PROVISION_DONE);
     tx_event_flags_set(&g_provision_lock, PROVISIONING_COMPLETED_FLAG, TX_OR);
 
     if (!provisioning) {
@@ -116,8 +123,12 @@ void gui_thread_entry(void)
                 if (SF_MESSAGE_EVENT_NEW_DATA == p_message->event_b.code) {
                     sf_touch_panel_payload_t * p_touch_message = (sf_touch_panel_payload_t *) p_message;
                     if (p_touch_message->event_type == SF_TOUCH_PANEL_EVENT_UP) {
-                        sprintf(event, "{\"touched\":true,\"x\":%d,\"y\":%d}", p_touch_message->x, p_touch_message->y);
-                        m1_publish_event(event, NULL);
+                        json_begin(&writer, event, sizeof(event));
+                        json_key_bool(&writer, "touched", true);
+                        json_key_int(&writer, "x", p_touch_message->x);
+                        json_key_int(&writer, "y", p_touch_message->y);
+                        if (json_end(&writer) > 0)
+                            event_batch_publish(event, EVENT_PRIORITY_INTERACTIVE);
                     }
                 }
                 break;
@@ -0,0 +1,262 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : i2c_worker.c
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Runs I2C cloud driver commands on one worker thread per
+ *                physical bus (I2C_MULTI_THREAD), so commands on different
+ *                buses run concurrently and a slow device only holds up
+ *                its own bus, not the sensor thread's UART, GPIO, batch
+ *                and poll work. The sensor thread dispatches a command of
+ *                the form 3;2;<READ_LENGTH>;<WRITE_LENGTH>;<TAG_NAME>;<DATA>
+ *                by the device address in the first byte of <DATA> to the
+ *                bus which has that device in buses[]. The worker owns the
+ *                command buffer from then on, and runs it through the
+ *                read cache. A reply with data is
+ *                published as it is; any other result is reported as
+ *                    {"i2c":{"bus":"<name>","status":<n>,"ms":<n>}}
+ *                with the M1 status and the time since the message was
+ *                received, so a write is confirmed and a failure is not
+ *                silent. Both carry the request ID of the message, if
+ *                any (see command_trace), as commands on different buses
+ *                complete out of order. A full bus queue holds up the
+ *                sensor thread rather than let a command overtake the
+ *                ones queued before it. Batches, chunked reads, polled
+ *                commands and I2C commands the workers do not take stay
+ *                on the sensor thread, which first waits for the workers
+ *                to finish their queued commands (i2c_worker_drain), so
+ *                the commands of a bus run in the order they were
+ *                received.
+ ******************************************************************************/
+
+#include <app.h>
+#include "sensor_thread.h"
+#include "i2c_worker.h"
+#include "command_pool.h"
+#include "event_batch.h"
+#include "json_writer.h"
+#include "read_cache.h"
+#include "bus_schedule.h"
+#include "command_trace.h"
+#include "timestamp.h"
+#include <m1_cloud_driver.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef I2C_MULTI_THREAD
+
+// idle flag of a bus
+#define I2C_WORKER_IDLE_FLAG    0x01
+
+typedef struct i2c_bus
+{
+    const char *                        name;
+    const sf_i2c_instance_t * const *   p_devices;
+    uint32_t                            device_count;
+    TX_THREAD                           thread;
+    TX_QUEUE                            queue;
+    TX_EVENT_FLAGS_GROUP                idle;
+    // commands dispatched and not yet completed, by the sensor thread and
+    // the worker, so only changed with interrupts disabled
+    volatile uint32_t                   pending;
+    ULONG                               queue_memory[I2C_WORKER_QUEUE_DEPTH * sizeof(command_trace_message_t) /
+                                                     sizeof(ULONG)];
+    ULONG                               stack[I2C_WORKER_STACK_SIZE / sizeof(ULONG)];
+    char                                reply[BUS_SCHEDULE_REPLY_SIZE];
+} i2c_bus_t;
+
+// the cloud driver devices, all on g_sf_i2c_bus0 (RIIC channel 2)
+static const sf_i2c_instance_t * const bus0_devices[] =
+{
+    &g_sf_i2c_device0, &g_sf_i2c_device1, &g_sf_i2c_device2, &g_sf_i2c_device3,
+};
+
+static i2c_bus_t buses[] =
+{
+    { .name = "bus0", .p_devices = bus0_devices, .device_count = sizeof(bus0_devices) / sizeof(bus0_devices[0]) },
+};
+
+/******************************************************************************
+* Function Name: i2c_worker_entry
+* Description  : Worker thread of one bus. Runs the commands of its queue in
+*                order and reports their completion.
+* Arguments    : index –
+*                    index of the bus in buses[].
+******************************************************************************/
+static void i2c_worker_entry(ULONG index) {
+    i2c_bus_t * p_bus = &buses[index];
+    command_trace_message_t message;
+    char eventbuf[128];
+    json_writer_t writer;
+    TX_INTERRUPT_SAVE_AREA
+
+    while (1) {
+        tx_queue_receive(&p_bus->queue, &message, TX_WAIT_FOREVER);
+        int status = read_cache_command(command_trace_command_of(message.p_command), p_bus->reply,
+                                        sizeof(p_bus->reply));
+
+        if (status == M1_SUCCESS_DATA) {
+            command_trace_id(message.p_command, p_bus->reply, sizeof(p_bus->reply));
+            event_batch_publish(p_bus->reply, EVENT_PRIORITY_REPLY);
+        } else {
+            json_begin(&writer, eventbuf, sizeof(eventbuf));
+            json_key_object(&writer, "i2c");
+            json_key_string(&writer, "bus", p_bus->name);
+            json_key_int(&writer, "status", status);
+            json_key_uint(&writer, "ms", (timestamp_us() - message.queued) / 1000);
+            json_end_object(&writer);
+            if (json_end(&writer) > 0 && command_trace_id(message.p_command, eventbuf, sizeof(eventbuf)) > 0)
+                event_batch_publish(eventbuf, EVENT_PRIORITY_REPLY);
+        }
+        command_trace_done(message.queued);
+        command_pool_free(message.p_command);
+
+        TX_DISABLE
+        bool idle = (--p_bus->pending == 0);
+        TX_RESTORE
+        if (idle)
+            tx_event_flags_set(&p_bus->idle, I2C_WORKER_IDLE_FLAG, TX_OR);
+    }
+}
+
+/******************************************************************************
+* Function Name: i2c_worker_bus
+* Description  : Finds the bus which has a device at an address.
+* Arguments    : address –
+*                    7-bit device address.
+* Return Value : the bus, or NULL if no configured device has the address.
+******************************************************************************/
+static i2c_bus_t * i2c_worker_bus(uint32_t address) {
+    for (unsigned int i = 0; i < sizeof(buses) / sizeof(buses[0]); i++) {
+        for (uint32_t d = 0; d < buses[i].device_count; d++) {
+            if (buses[i].p_devices[d]->p_cfg->device_address == address)
+                return &buses[i];
+        }
+    }
+    return NULL;
+}
+
+#endif
+
+/******************************************************************************
+* Function Name: i2c_worker_init
+* Description  : Creates the queue and worker thread of every bus. Must be
+*                called once, after the devices are opened and registered
+*                with the cloud driver.
+******************************************************************************/
+void i2c_worker_init(void) {
+#ifdef I2C_MULTI_THREAD
+    for (unsigned int i = 0; i < sizeof(buses) / sizeof(buses[0]); i++) {
+        i2c_bus_t * p_bus = &buses[i];
+        UINT status = tx_queue_create(&p_bus->queue, "I2C Worker Queue",
+                                      sizeof(command_trace_message_t) / sizeof(ULONG), p_bus->queue_memory,
+                                      sizeof(p_bus->queue_memory));
+        APP_ERR_TRAP(status);
+        status = tx_event_flags_create(&p_bus->idle, "I2C Worker Idle");
+        APP_ERR_TRAP(status);
+        status = tx_thread_create(&p_bus->thread, "I2C Worker Thread", i2c_worker_entry, i,
+                                  p_bus->stack, sizeof(p_bus->stack), I2C_WORKER_PRIORITY, I2C_WORKER_PRIORITY,
+                                  1, TX_AUTO_START);
+        APP_ERR_TRAP(status);
+    }
+#endif
+}
+
+/******************************************************************************
+* Function Name: i2c_worker_dispatch
+* Description  : Hands an I2C read & write command to the worker of its bus.
+* Arguments    : p_command –
+*                    null-terminated cloud driver command in a command pool
+*                    buffer, with its prefixes.
+*                queued -
+*                    timestamp_us the message was received at.
+* Return Value : true if a worker took the command and now owns the buffer,
+*                after waiting for room in the bus queue if it was full.
+*                false if it is not an I2C command for a known device, or
+*                workers are not built in; the caller then runs it itself,
+*                after i2c_worker_drain.
+******************************************************************************/
+bool i2c_worker_dispatch(char * p_command, uint32_t queued) {
+#ifdef I2C_MULTI_THREAD
+    unsigned int read_length;
+    unsigned int write_length;
+    int n = 0;
+    command_trace_message_t message;
+    TX_INTERRUPT_SAVE_AREA
+
+    const char * p_i2c = read_cache_command_of(command_trace_command_of(p_command));
+
+    if (sscanf(p_i2c, "3;2;%u;%u;%n", &read_length, &write_length, &n) != 2 || n == 0 || write_length == 0)
+        return false;
+    const char * p_data = strchr(&p_i2c[n], ';');
+    if (p_data == NULL || p_data[1] == '\0')
+        return false;
+    i2c_bus_t * p_bus = i2c_worker_bus((uint8_t)p_data[1]);
+    if (p_bus == NULL)
+        return false;
+
+    message.p_command = p_command;
+    message.queued = queued;
+    TX_DISABLE
+    p_bus->pending++;
+    TX_RESTORE
+    if (tx_queue_send(&p_bus->queue, &message, TX_WAIT_FOREVER) != TX_SUCCESS) {
+        TX_DISABLE
+        p_bus->pending--;
+        TX_RESTORE
+        return false;
+    }
+    return true;
+#else
+    SSP_PARAMETER_NOT_USED(p_command);
+    SSP_PARAMETER_NOT_USED(queued);
+    return false;
+#endif
+}
+
+/******************************************************************************
+* Function Name: i2c_worker_drain
+* Description  : Waits until the workers have completed every command handed
+*                to them, before the sensor thread runs I2C commands itself.
+*                Only called by the sensor thread, which is also the only
+*                one to dispatch, so no command is added meanwhile.
+******************************************************************************/
+void i2c_worker_drain(void) {
+#ifdef I2C_MULTI_THREAD
+    ULONG actual;
+    TX_INTERRUPT_SAVE_AREA
+
+    for (unsigned int i = 0; i < sizeof(buses) / sizeof(buses[0]); i++) {
+        i2c_bus_t * p_bus = &buses[i];
+        while (1) {
+            TX_DISABLE
+            bool idle = (p_bus->pending == 0);
+            TX_RESTORE
+            if (idle)
+                break;
+            // the flag may be left from an earlier idle moment, so check again
+            tx_event_flags_get(&p_bus->idle, I2C_WORKER_IDLE_FLAG, TX_OR_CLEAR, &actual, TX_WAIT_FOREVER);
+        }
+    }
+#endif
+}
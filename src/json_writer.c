@@ -0,0 +1,565 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : json_writer.c
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Builds JSON objects into a caller-provided buffer without
+ *                printf or allocation. Numbers are formatted with integer
+ *                arithmetic only; floats are written with a fixed number of
+ *                decimals. Every write is length checked: once something
+ *                does not fit the writer stops and json_end reports the
+ *                overflow, so a truncated event is never published.
+ *                Usage:
+ *                    json_begin(&writer, buf, sizeof(buf));
+ *                    json_key_float(&writer, "x_avg", x, 4);
+ *                    len = json_end(&writer);
+ *                Started with json_begin_cbor, the same calls encode the
+ *                object as CBOR instead (RFC 7049), which json_end wraps as
+ *                    {"cbor":"<base64>"}
+ *                since M1 only accepts JSON payloads. Keys listed in
+ *                cbor_keys are sent as their index, other keys as text.
+ *                Floats are sent as half precision when that keeps the
+ *                requested decimals, else as single precision. The
+ *                encoding is reversed by tools/cbor_decode.py.
+ ******************************************************************************/
+
+#include "json_writer.h"
+
+#include <string.h>
+
+// decimals of json_key_float are clamped to this
+#define JSON_FLOAT_DECIMALS_MAX 6
+
+static const uint32_t decimal_scale[JSON_FLOAT_DECIMALS_MAX + 1] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+
+// CBOR major types
+#define CBOR_UINT   0
+#define CBOR_NINT   1
+#define CBOR_TEXT   3
+#define CBOR_MAP    5
+#define CBOR_SIMPLE 7
+
+#define CBOR_FALSE          0xf4
+#define CBOR_TRUE           0xf5
+#define CBOR_NULL           0xf6
+#define CBOR_HALF           0xf9
+#define CBOR_SINGLE         0xfa
+#define CBOR_MAP_INDEFINITE 0xbf
+#define CBOR_BREAK          0xff
+
+// {"cbor":"  "}
+#define CBOR_ENVELOPE_HEAD "{\"cbor\":\""
+#define CBOR_ENVELOPE_TAIL "\"}"
+
+// keys sent as integers in CBOR; append only, tools/cbor_decode.py has the same table
+static const char * const cbor_keys[] = {
+    "x_max", "x_min", "x_avg",
+    "y_max", "y_min", "y_avg",
+    "z_max", "z_min", "z_avg",
+    "sample_cnt", "window_ms", "energy",
+    "impact_cnt", "impact_peak_g", "impact_peak_ms", "temp_c",
+    "x_zero_cross", "y_zero_cross", "z_zero_cross",
+    "mag_cnt", "mag_field_max", "mag_field_min", "mag_field_avg", "mag_heading", "motor_on",
+    "snapshot",
+};
+
+/******************************************************************************
+* Function Name: json_put
+* Description  : Appends bytes to the output, keeping it null-terminated.
+* Arguments    : p_writer –
+*                    writer state.
+*                p_src -
+*                    bytes to append.
+*                length -
+*                    number of bytes.
+******************************************************************************/
+static void json_put(json_writer_t * p_writer, const char * p_src, size_t length) {
+    if (p_writer->overflow || p_writer->len + length >= p_writer->size) {
+        p_writer->overflow = true;
+        return;
+    }
+    memcpy(&p_writer->p_buf[p_writer->len], p_src, length);
+    p_writer->len += length;
+    p_writer->p_buf[p_writer->len] = '\0';
+}
+
+/******************************************************************************
+* Function Name: json_put_uint
+* Description  : Appends an unsigned decimal number, zero padded to at least
+*                min_digits digits.
+* Arguments    : p_writer –
+*                    writer state.
+*                value -
+*                    number to append.
+*                min_digits -
+*                    minimum number of digits.
+******************************************************************************/
+static void json_put_uint(json_writer_t * p_writer, uint32_t value, int min_digits) {
+    char digits[10];
+    int n = 0;
+
+    do {
+        digits[sizeof(digits) - 1 - (unsigned int)n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value || n < min_digits);
+    json_put(p_writer, &digits[sizeof(digits) - (unsigned int)n], (size_t)n);
+}
+
+/******************************************************************************
+* Function Name: cbor_head
+* Description  : Appends a CBOR initial byte with its argument in the
+*                shortest form.
+* Arguments    : p_writer –
+*                    writer state.
+*                major -
+*                    major type.
+*                value -
+*                    argument.
+******************************************************************************/
+static void cbor_head(json_writer_t * p_writer, uint8_t major, uint32_t value) {
+    char head[5];
+    size_t length;
+
+    if (value < 24) {
+        head[0] = (char)((major << 5) | value);
+        length = 1;
+    } else if (value <= 0xff) {
+        head[0] = (char)((major << 5) | 24);
+        head[1] = (char)value;
+        length = 2;
+    } else if (value <= 0xffff) {
+        head[0] = (char)((major << 5) | 25);
+        head[1] = (char)(value >> 8);
+        head[2] = (char)value;
+        length = 3;
+    } else {
+        head[0] = (char)((major << 5) | 26);
+        head[1] = (char)(value >> 24);
+        head[2] = (char)(value >> 16);
+        head[3] = (char)(value >> 8);
+        head[4] = (char)value;
+        length = 5;
+    }
+    json_put(p_writer, head, length);
+}
+
+/******************************************************************************
+* Function Name: cbor_byte
+* Description  : Appends a single CBOR byte.
+* Arguments    : p_writer –
+*                    writer state.
+*                value -
+*                    byte to append.
+******************************************************************************/
+static void cbor_byte(json_writer_t * p_writer, uint8_t value) {
+    char byte = (char)value;
+
+    json_put(p_writer, &byte, 1);
+}
+
+/******************************************************************************
+* Function Name: cbor_half
+* Description  : Converts a float to half precision if the result stays
+*                within tolerance of the value.
+* Arguments    : value –
+*                    value to convert.
+*                tolerance -
+*                    largest acceptable error.
+*                p_half -
+*                    receives the half precision bits.
+* Return Value : true if the half precision value is close enough.
+******************************************************************************/
+static bool cbor_half(float value, float tolerance, uint16_t * p_half) {
+    uint32_t bits;
+    float back;
+    float error;
+
+    memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+    int32_t exponent = (int32_t)((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if ((bits & 0x7fffffff) == 0) {
+        *p_half = sign;
+        return true;
+    }
+    // subnormal halves are not used, small values go out as single precision
+    if (exponent <= 0 || exponent >= 31)
+        return false;
+    mantissa += 0x1000;
+    if (mantissa & 0x800000) {
+        mantissa = 0;
+        if (++exponent >= 31)
+            return false;
+    }
+    *p_half = (uint16_t)(sign | (uint32_t)exponent << 10 | mantissa >> 13);
+
+    bits = (uint32_t)sign << 16 | (uint32_t)(exponent - 15 + 127) << 23 | (mantissa >> 13) << 13;
+    memcpy(&back, &bits, sizeof(back));
+    error = (back > value) ? back - value : value - back;
+    return error <= tolerance;
+}
+
+/******************************************************************************
+* Function Name: cbor_envelope
+* Description  : Replaces the CBOR bytes in the buffer by the JSON envelope
+*                holding them in base64. Encodes from the last group back,
+*                so the output never overwrites input still to be read.
+* Arguments    : p_writer –
+*                    writer state.
+******************************************************************************/
+static void cbor_envelope(json_writer_t * p_writer) {
+    static const char base64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t head_len = sizeof(CBOR_ENVELOPE_HEAD) - 1;
+    size_t tail_len = sizeof(CBOR_ENVELOPE_TAIL) - 1;
+    size_t groups = (p_writer->len + 2) / 3;
+    size_t out_len = head_len + groups * 4 + tail_len;
+    uint8_t * p_in = (uint8_t *)p_writer->p_buf;
+    char * p_out = p_writer->p_buf;
+
+    if (p_writer->overflow || out_len >= p_writer->size) {
+        p_writer->overflow = true;
+        return;
+    }
+    for (size_t g = groups; g-- > 0;) {
+        size_t remain = p_writer->len - g * 3;
+        uint32_t triple = (uint32_t)p_in[g * 3] << 16;
+        if (remain > 1)
+            triple |= (uint32_t)p_in[g * 3 + 1] << 8;
+        if (remain > 2)
+            triple |= p_in[g * 3 + 2];
+        char * p_group = &p_out[head_len + g * 4];
+        p_group[0] = base64[(triple >> 18) & 0x3f];
+        p_group[1] = base64[(triple >> 12) & 0x3f];
+        p_group[2] = (remain > 1) ? base64[(triple >> 6) & 0x3f] : '=';
+        p_group[3] = (remain > 2) ? base64[triple & 0x3f] : '=';
+    }
+    memcpy(p_out, CBOR_ENVELOPE_HEAD, head_len);
+    memcpy(&p_out[out_len - tail_len], CBOR_ENVELOPE_TAIL, tail_len);
+    p_out[out_len] = '\0';
+    p_writer->len = out_len;
+}
+
+/******************************************************************************
+* Function Name: json_key
+* Description  : Appends the separator and the quoted key of a new member.
+* Arguments    : p_writer –
+*                    writer state.
+*                key -
+*                    member name, must not need escaping.
+******************************************************************************/
+static void json_key(json_writer_t * p_writer, const char * key) {
+    if (p_writer->cbor) {
+        for (uint32_t i = 0; i < sizeof(cbor_keys) / sizeof(cbor_keys[0]); i++) {
+            if (!strcmp(key, cbor_keys[i])) {
+                cbor_head(p_writer, CBOR_UINT, i);
+                return;
+            }
+        }
+        cbor_head(p_writer, CBOR_TEXT, (uint32_t)strlen(key));
+        json_put(p_writer, key, strlen(key));
+        return;
+    }
+    if (!p_writer->first)
+        json_put(p_writer, ",", 1);
+    p_writer->first = false;
+    json_put(p_writer, "\"", 1);
+    json_put(p_writer, key, strlen(key));
+    json_put(p_writer, "\":", 2);
+}
+
+/******************************************************************************
+* Function Name: json_begin
+* Description  : Starts a new top-level object.
+* Arguments    : p_writer –
+*                    writer state.
+*                p_buf -
+*                    output buffer.
+*                size -
+*                    size of the output buffer, including the terminator.
+******************************************************************************/
+void json_begin(json_writer_t * p_writer, char * p_buf, size_t size) {
+    p_writer->p_buf = p_buf;
+    p_writer->size = size;
+    p_writer->len = 0;
+    p_writer->first = true;
+    p_writer->overflow = (size == 0);
+    p_writer->cbor = false;
+    json_put(p_writer, "{", 1);
+}
+
+/******************************************************************************
+* Function Name: json_begin_cbor
+* Description  : Starts a new top-level object encoded as CBOR.
+* Arguments    : p_writer –
+*                    writer state.
+*                p_buf -
+*                    output buffer, also holds the CBOR until json_end.
+*                size -
+*                    size of the output buffer, including the terminator.
+******************************************************************************/
+void json_begin_cbor(json_writer_t * p_writer, char * p_buf, size_t size) {
+    p_writer->p_buf = p_buf;
+    p_writer->size = size;
+    p_writer->len = 0;
+    p_writer->first = true;
+    p_writer->overflow = (size == 0);
+    p_writer->cbor = true;
+    cbor_byte(p_writer, CBOR_MAP_INDEFINITE);
+}
+
+/******************************************************************************
+* Function Name: json_key_object
+* Description  : Starts a nested object member. Close with json_end_object.
+* Arguments    : p_writer –
+*                    writer state.
+*                key -
+*                    member name.
+******************************************************************************/
+void json_key_object(json_writer_t * p_writer, const char * key) {
+    json_key(p_writer, key);
+    if (p_writer->cbor)
+        cbor_byte(p_writer, CBOR_MAP_INDEFINITE);
+    else
+        json_put(p_writer, "{", 1);
+    p_writer->first = true;
+}
+
+/******************************************************************************
+* Function Name: json_end_object
+* Description  : Closes a nested object member.
+* Arguments    : p_writer –
+*                    writer state.
+******************************************************************************/
+void json_end_object(json_writer_t * p_writer) {
+    if (p_writer->cbor)
+        cbor_byte(p_writer, CBOR_BREAK);
+    else
+        json_put(p_writer, "}", 1);
+    p_writer->first = false;
+}
+
+/******************************************************************************
+* Function Name: json_key_int
+* Description  : Appends a signed integer member.
+* Arguments    : p_writer –
+*                    writer state.
+*                key -
+*                    member name.
+*                value -
+*                    member value.
+******************************************************************************/
+void json_key_int(json_writer_t * p_writer, const char * key, int32_t value) {
+    json_key(p_writer, key);
+    if (p_writer->cbor) {
+        if (value < 0)
+            cbor_head(p_writer, CBOR_NINT, (uint32_t)(-1 - value));
+        else
+            cbor_head(p_writer, CBOR_UINT, (uint32_t)value);
+    } else if (value < 0) {
+        json_put(p_writer, "-", 1);
+        json_put_uint(p_writer, (uint32_t)0 - (uint32_t)value, 1);
+    } else {
+        json_put_uint(p_writer, (uint32_t)value, 1);
+    }
+}
+
+/******************************************************************************
+* Function Name: json_key_uint
+* Description  : Appends an unsigned integer member.
+* Arguments    : p_writer –
+*                    writer state.
+*                key -
+*                    member name.
+*                value -
+*                    member value.
+******************************************************************************/
+void json_key_uint(json_writer_t * p_writer, const char * key, uint32_t value) {
+    json_key(p_writer, key);
+    if (p_writer->cbor)
+        cbor_head(p_writer, CBOR_UINT, value);
+    else
+        json_put_uint(p_writer, value, 1);
+}
+
+/******************************************************************************
+* Function Name: json_key_float
+* Description  : Appends a float member rounded to a fixed number of
+*                decimals. Values which are not finite or do not fit 32 bits
+*                once scaled are written as null.
+* Arguments    : p_writer –
+*                    writer state.
+*                key -
+*                    member name.
+*                value -
+*                    member value.
+*                decimals -
+*                    digits after the decimal point, 0 to 6.
+******************************************************************************/
+void json_key_float(json_writer_t * p_writer, const char * key, float value, int decimals) {
+    bool negative = value < 0;
+    float scaled;
+    uint32_t fixed;
+
+    if (decimals < 0)
+        decimals = 0;
+    if (decimals > JSON_FLOAT_DECIMALS_MAX)
+        decimals = JSON_FLOAT_DECIMALS_MAX;
+    json_key(p_writer, key);
+    scaled = (negative ? -value : value) * (float)decimal_scale[decimals] + 0.5f;
+    // also false for NaN
+    if (!(scaled < 4294967040.0f)) {
+        if (p_writer->cbor)
+            cbor_byte(p_writer, CBOR_NULL);
+        else
+            json_put(p_writer, "null", 4);
+        return;
+    }
+    if (p_writer->cbor) {
+        uint16_t half;
+        if (cbor_half(value, 0.5f / (float)decimal_scale[decimals], &half)) {
+            cbor_byte(p_writer, CBOR_HALF);
+            cbor_byte(p_writer, (uint8_t)(half >> 8));
+            cbor_byte(p_writer, (uint8_t)half);
+        } else {
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            cbor_byte(p_writer, CBOR_SINGLE);
+            cbor_byte(p_writer, (uint8_t)(bits >> 24));
+            cbor_byte(p_writer, (uint8_t)(bits >> 16));
+            cbor_byte(p_writer, (uint8_t)(bits >> 8));
+            cbor_byte(p_writer, (uint8_t)bits);
+        }
+        return;
+    }
+    fixed = (uint32_t)scaled;
+    if (negative && fixed)
+        json_put(p_writer, "-", 1);
+    json_put_uint(p_writer, fixed / decimal_scale[decimals], 1);
+    if (decimals) {
+        json_put(p_writer, ".", 1);
+        json_put_uint(p_writer, fixed % decimal_scale[decimals], decimals);
+    }
+}
+
+/******************************************************************************
+* Function Name: json_key_bool
+* Description  : Appends a boolean member.
+* Arguments    : p_writer –
+*                    writer state.
+*                key -
+*                    member name.
+*                value -
+*                    member value.
+******************************************************************************/
+void json_key_bool(json_writer_t * p_writer, const char * key, bool value) {
+    json_key(p_writer, key);
+    if (p_writer->cbor)
+        cbor_byte(p_writer, value ? CBOR_TRUE : CBOR_FALSE);
+    else if (value)
+        json_put(p_writer, "true", 4);
+    else
+        json_put(p_writer, "false", 5);
+}
+
+/******************************************************************************
+* Function Name: json_key_string
+* Description  : Appends a string member, escaping quotes, backslashes and
+*                control characters.
+* Arguments    : p_writer –
+*                    writer state.
+*                key -
+*                    member name.
+*                value -
+*                    null-terminated member value.
+******************************************************************************/
+void json_key_string(json_writer_t * p_writer, const char * key, const char * value) {
+    static const char hex[] = "0123456789abcdef";
+
+    json_key(p_writer, key);
+    if (p_writer->cbor) {
+        cbor_head(p_writer, CBOR_TEXT, (uint32_t)strlen(value));
+        json_put(p_writer, value, strlen(value));
+        return;
+    }
+    json_put(p_writer, "\"", 1);
+    for (const char * p = value; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            char escaped[2] = {'\\', *p};
+            json_put(p_writer, escaped, 2);
+        } else if ((unsigned char)*p < 0x20) {
+            char escaped[6] = {'\\', 'u', '0', '0', hex[(*p >> 4) & 0x0f], hex[*p & 0x0f]};
+            json_put(p_writer, escaped, 6);
+        } else {
+            json_put(p_writer, p, 1);
+        }
+    }
+    json_put(p_writer, "\"", 1);
+}
+
+/******************************************************************************
+* Function Name: json_members
+* Description  : Appends the members of a complete JSON object, such as a
+*                cloud driver reply, to the current object. The members are
+*                copied as they are, so their keys must not clash with the
+*                others. Only JSON output can take them; a CBOR writer, or
+*                text which is not an object, overflows the writer.
+* Arguments    : p_writer –
+*                    writer state.
+*                json -
+*                    null-terminated JSON object.
+******************************************************************************/
+void json_members(json_writer_t * p_writer, const char * json) {
+    const char * p_first = strchr(json, '{');
+    const char * p_last = strrchr(json, '}');
+
+    if (p_writer->cbor || p_first == NULL || p_last == NULL || p_last < p_first) {
+        p_writer->overflow = true;
+        return;
+    }
+    for (p_first++; p_first < p_last && (*p_first == ' ' || *p_first == '\n'); p_first++)
+        ;
+    if (p_first == p_last)
+        return;
+    if (!p_writer->first)
+        json_put(p_writer, ",", 1);
+    p_writer->first = false;
+    json_put(p_writer, p_first, (size_t)(p_last - p_first));
+}
+
+/******************************************************************************
+* Function Name: json_end
+* Description  : Closes the top-level object, and for CBOR wraps it in its
+*                JSON envelope.
+* Arguments    : p_writer –
+*                    writer state.
+* Return Value : Length of the JSON text, or -1 if it did not fit the buffer.
+******************************************************************************/
+int json_end(json_writer_t * p_writer) {
+    if (p_writer->cbor) {
+        cbor_byte(p_writer, CBOR_BREAK);
+        cbor_envelope(p_writer);
+    } else {
+        json_put(p_writer, "}", 1);
+    }
+    return p_writer->overflow ? -1 : (int)p_writer->len;
+}
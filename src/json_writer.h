@@ -0,0 +1,58 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : json_writer.h
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Minimal JSON object writer for outbound events, with an
+ *                optional CBOR encoding.
+ ******************************************************************************/
+
+#ifndef JSON_WRITER_H_
+#define JSON_WRITER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct json_writer
+{
+    char *  p_buf;
+    size_t  size;
+    size_t  len;
+    bool    first;      ///< no member written yet in the current object.
+    bool    overflow;   ///< a write did not fit, the output is unusable.
+    bool    cbor;       ///< encoding CBOR instead of JSON text.
+} json_writer_t;
+
+void json_begin(json_writer_t * p_writer, char * p_buf, size_t size);
+void json_begin_cbor(json_writer_t * p_writer, char * p_buf, size_t size);
+void json_key_object(json_writer_t * p_writer, const char * key);
+void json_end_object(json_writer_t * p_writer);
+void json_key_int(json_writer_t * p_writer, const char * key, int32_t value);
+void json_key_uint(json_writer_t * p_writer, const char * key, uint32_t value);
+void json_key_float(json_writer_t * p_writer, const char * key, float value, int decimals);
+void json_key_bool(json_writer_t * p_writer, const char * key, bool value);
+void json_key_string(json_writer_t * p_writer, const char * key, const char * value);
+void json_members(json_writer_t * p_writer, const char * json);
+int json_end(json_writer_t * p_writer);
+
+#endif /* JSON_WRITER_H_ */
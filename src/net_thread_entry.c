@@ -30,6 +30,12 @@
 #include <app.h>
 #include "net_thread.h"
 #include "vibration_detection_thread.h"
+#include "data_flash.h"
+#include "event_batch.h"
+#include "connection.h"
+#include "command_pool.h"
+#include "bus_schedule.h"
+#include "read_cache.h"
 #include "r_fmi.h"
 #include "sf_wifi_api.h"
 #include "fx_api.h"
@@ -52,9 +58,6 @@
 #define APP_USB_INS_FLAG    (0x1UL)
 #define APP_USB_REM_FLAG    (0x2UL)
 
-#define DATA_FLASH_BLOCK_SIZE 64
-#define DATA_FLASH_PROGRAMMING_UNIT 4
-
 void net_thread_entry(void);
 
 extern TX_THREAD net_thread;
@@ -91,6 +94,8 @@ NX_DNS           g_dns_client;
 #define IP_THREAD_SIZE  (10 * 1024)
 #endif
 #define DHCP_STACK_SIZE  (2 * 1024)
+// TLS working memory for the M1 agent, which would otherwise take it from the heap
+#define SSL_MEM_SIZE    (30 * 1024)
 #define HTTP_STACK_SIZE (4 * 1024)
 
 
@@ -98,6 +103,7 @@ static CHAR mem_packet_pool[(BLOCK_SIZE + 32 + sizeof(NX_PACKET)) * NUM_IP_PACKE
 static CHAR mem_ip_stack[IP_THREAD_SIZE] __attribute__ ((aligned(4)));
 static CHAR mem_arp[768] __attribute__ ((aligned(4)));
 static CHAR mem_http_stack[HTTP_STACK_SIZE]  __attribute__ ((aligned(4)));
+static CHAR mem_ssl[SSL_MEM_SIZE] __attribute__ ((aligned(8)));
 static CHAR dhcp_server_stack [DHCP_STACK_SIZE];
 static char dhcp_buffer_pool_memory [BLOCK_SIZE*NUM_PACKETS];
 
@@ -115,6 +121,9 @@ char m1_mqtt_user_id[32];
 char m1_mqtt_project_id[32];
 char m1_device_id[33] = "s3a7";
 
+static project_credentials_t m1_project;
+static user_credentials_t m1_device;
+
 static ioport_port_pin_t leds[4] =
 {
     IOPORT_PORT_07_PIN_00,  /* RED */
@@ -163,16 +172,23 @@ static void urldecode(UCHAR * buffer, int length) {
 *                provisioning or normal mode. In provisioning mode, launches
 *                HTTP server and stores credentials to data-flash. In normal
 *                mode, reads credentials from data-flash and connects to
-*                the cloud using M1 VSA.
+*                the cloud using M1 VSA (see connection), then runs the
+*                outbound event batching loop (see event_batch).
 ******************************************************************************/
 void net_thread_entry(void) {
     UINT  status;
     ULONG actual_flags;
-    ULONG ip_status, dhcp_status;
+    ULONG ip_status;
     ssp_err_t ssp_err;
     UINT addresses_added;
     UCHAR provisionConfigBuffer[300];
 
+    data_flash_init();
+    event_batch_init();
+    command_pool_init();
+    bus_schedule_init();
+    read_cache_init();
+    connection_init();
     nx_system_initialize();
     status = nx_packet_pool_create(&g_http_packet_pool,
                                    "HTTP Packet Pool",
@@ -244,11 +260,7 @@ void net_thread_entry(void) {
         status = nx_dhcp_server_start(&dhcp_server);
         APP_ERR_TRAP(status);
     } else {
-        ssp_err = g_flash0.p_api->open(g_flash0.p_ctrl, g_flash0.p_cfg);
-        APP_ERR_TRAP(ssp_err);
-        ssp_err = g_flash0.p_api->read(g_flash0.p_ctrl, provisionConfigBuffer, 0x40100000, sizeof(provisionConfigBuffer) - 1);
-        APP_ERR_TRAP(ssp_err);
-        ssp_err = g_flash0.p_api->close(g_flash0.p_ctrl);
+        ssp_err = data_flash_read(DATA_FLASH_PROVISION_ADDRESS, provisionConfigBuffer, sizeof(provisionConfigBuffer) - 1);
         APP_ERR_TRAP(ssp_err);
         actual_size = strnlen((char *)provisionConfigBuffer, sizeof(provisionConfigBuffer) - 1);
 #if 0//def USB_PROVISION
@@ -342,9 +354,6 @@ void net_thread_entry(void) {
         prov.channel = !(rand() % 3) ? 1 : !(rand() % 2) ? 6 : 11;
     } else {
         prov.mode = SF_WIFI_INTERFACE_MODE_CLIENT;
-        BufferLine(1, "Connecting to SSID:");
-        BufferLine(2, (char *)prov.ssid);
-        PaintText();
         switch (prov.security) {
             case SF_WIFI_SECURITY_TYPE_WPA2:
                 prov.encryption = SF_WIFI_ENCRYPTION_TYPE_CCMP;
@@ -360,28 +369,12 @@ void net_thread_entry(void) {
         }
     }
 
-    do {
-        ssp_err = g_sf_wifi0.p_api->provisioningSet(g_sf_wifi0.p_ctrl, &prov);
-    } while (ssp_err != SSP_SUCCESS);
-    APP_ERR_TRAP(ssp_err);
-
-
-    if (!provisioning) {
-        g_ioport.p_api->pinWrite(leds[2], IOPORT_LEVEL_HIGH);
-        BufferLine(1, "Connected. Resolving IP address...");
-        BufferLine(2, "");
-        PaintText();
-
-        status = nx_dhcp_start(&g_dhcp);
-        APP_ERR_TRAP(status);
-
-        status = nx_dns_server_add(&g_dns_client, (8L << 24) + (8L << 16) + (8L << 8) + 8L);
-        APP_ERR_TRAP(status);
-
-        nx_ip_status_check(&g_http_ip, NX_IP_ADDRESS_RESOLVED, &dhcp_status, NX_WAIT_FOREVER);
-        BufferLine(1, "IP address resolved.");
-        BufferLine(2, "Connecting to MQTT");
-        PaintText();
+    // in client mode the access point is joined by the connection manager
+    if (provisioning) {
+        do {
+            ssp_err = g_sf_wifi0.p_api->provisioningSet(g_sf_wifi0.p_ctrl, &prov);
+        } while (ssp_err != SSP_SUCCESS);
+        APP_ERR_TRAP(ssp_err);
     }
 
     while (1)
@@ -439,26 +432,32 @@ void net_thread_entry(void) {
             PaintText();
             tx_thread_suspend(&net_thread);
         } else {
+            connection_cfg_t connection_cfg =
+            {
+                .p_prov = &prov,
+                .p_pool = &g_http_packet_pool,
+                .p_ip = &g_http_ip,
+                .p_dhcp = &g_dhcp,
+                .p_dns = &g_dns_client,
+                .mqtt_host = "mqtt2.mediumone.com",
+                .mqtt_port = 61620,
+                .p_project = &m1_project,
+                .p_device = &m1_device,
+                .device_id = m1_device_id,
+                .p_ssl_mem = mem_ssl,
+                .ssl_mem_size = sizeof(mem_ssl),
+            };
+            snprintf(m1_project.apikey, sizeof(m1_project.apikey), "%s", m1_apikey);
+            snprintf(m1_project.proj_id, sizeof(m1_project.proj_id), "%s", m1_mqtt_project_id);
+            snprintf(m1_device.user_id, sizeof(m1_device.user_id), "%s", m1_mqtt_user_id);
+            snprintf(m1_device.password, sizeof(m1_device.password), "%s", m1_password);
             m1_register_subscription_callback(m1_message_callback);
-            do {
-                status = (UINT)m1_connect("mqtt2.mediumone.com",
-                           61620,
-                           m1_mqtt_user_id,
-                           m1_password,
-                           m1_mqtt_project_id,
-                           m1_apikey,
-                           "s3a7",
-                           5,
-                           5,
-                           60,
-                           1);
-            } while (status != M1_SUCCESS);
-            BufferLine(1, "Connected!");
-            BufferLine(2, "");
-            PaintText();
-            m1_publish_event("{\"kit_version\":\"1.0.0\"}", NULL);
+            connection_run(&connection_cfg);
+            g_ioport.p_api->pinWrite(leds[2], IOPORT_LEVEL_HIGH);
+            event_batch_publish("{\"kit_version\":\"1.0.0\"}", EVENT_PRIORITY_BULK);
             tx_thread_resume(&vibration_detection_thread);
-            tx_thread_suspend(&net_thread);
+            // net_thread has nothing else to do, so it flushes outbound events
+            event_batch_run();
         }
         if (provisioning) {
             status = nx_http_server_stop(&g_http_server);
@@ -528,21 +527,7 @@ UINT my_get_notify(NX_HTTP_SERVER *server_ptr, UINT request_type, CHAR *resource
             formdecode[0] = ' ';
             formdecode = (UCHAR *)strchr((char *)&formdecode[1], '+');
         }
-        ssp_err = g_flash0.p_api->open(g_flash0.p_ctrl, g_flash0.p_cfg);
-        APP_ERR_TRAP(ssp_err);
-
-        uint32_t blocks = 0;
-        int temp_length = (int)(length + 1);
-        while (temp_length > 0) {
-            blocks++;
-            temp_length -= DATA_FLASH_BLOCK_SIZE;
-        }
-        ssp_err = g_flash0.p_api->erase(g_flash0.p_ctrl, 0x40100000, blocks);
-        APP_ERR_TRAP(ssp_err);
-        ssp_err = g_flash0.p_api->write(g_flash0.p_ctrl, (uint32_t)provisionConfigBuffer, 0x40100000,
-                                        (length + DATA_FLASH_PROGRAMMING_UNIT) & (UINT)(~(DATA_FLASH_PROGRAMMING_UNIT - 1)));
-        APP_ERR_TRAP(ssp_err);
-        ssp_err = g_flash0.p_api->close(g_flash0.p_ctrl);
+        ssp_err = data_flash_write(DATA_FLASH_PROVISION_ADDRESS, provisionConfigBuffer, length + 1);
         APP_ERR_TRAP(ssp_err);
 
         PaintScreen((uint8_t *) m1provisionend);
@@ -0,0 +1,177 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : poll.c
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Runs registered cloud driver commands at a fixed period on
+ *                the sensor thread, so steady-state polling needs no
+ *                downstream traffic and the sampling interval does not
+ *                depend on cloud latency. A command is registered with
+ *                    P<slot>;<period_ms>;<report>;<command>
+ *                where <command> is a cloud driver command or a batch (see
+ *                command_batch), and a period of 0 clears the slot. The
+ *                first run is immediate; later runs keep to the period's
+ *                grid, skipping runs the thread was too busy for. Replies
+ *                are published as bulk events. With <report> 0 every
+ *                reply is published; with N > 0 only replies which differ
+ *                from the last published one are, plus every Nth
+ *                unchanged one so the cloud can tell a quiet sensor from a
+ *                lost device.
+ ******************************************************************************/
+
+#include <app.h>
+#include "tx_api.h"
+#include "poll.h"
+#include "command_batch.h"
+#include "bus_schedule.h"
+#include "i2c_worker.h"
+#include "event_batch.h"
+#include <m1_cloud_driver.h>
+
+#include <stdio.h>
+#include <string.h>
+
+typedef struct poll_slot
+{
+    char        command[POLL_COMMAND_SIZE];
+    ULONG       period;     ///< ticks, 0 while the slot is free.
+    ULONG       due;
+    uint32_t    report;
+    uint32_t    unchanged;  ///< replies held back since the last publish.
+    uint32_t    hash;       ///< of the last published reply.
+    bool        valid;      ///< hash is set.
+} poll_slot_t;
+
+static poll_slot_t slots[POLL_SLOTS];
+
+// only used by sensor_thread, so kept off its stack
+static char reply[BUS_SCHEDULE_REPLY_SIZE];
+
+/******************************************************************************
+* Function Name: poll_hash
+* Description  : FNV-1a hash of a string, to spot unchanged replies without
+*                keeping them.
+* Arguments    : p_text –
+*                    null-terminated string.
+* Return Value : hash.
+******************************************************************************/
+static uint32_t poll_hash(const char * p_text) {
+    uint32_t hash = 2166136261UL;
+
+    while (*p_text) {
+        hash ^= (uint8_t)*p_text++;
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+/******************************************************************************
+* Function Name: poll_execute
+* Description  : Runs the command of a slot and publishes the reply unless
+*                change-only reporting holds it back.
+* Arguments    : p_slot –
+*                    slot to run.
+******************************************************************************/
+static void poll_execute(poll_slot_t * p_slot) {
+    uint32_t hash;
+
+    // after the I2C commands received before this run
+    i2c_worker_drain();
+    if (p_slot->command[0] == COMMAND_BATCH_MARKER) {
+        if (command_batch_run(p_slot->command, reply, sizeof(reply)) <= 0)
+            return;
+    } else if (bus_schedule_command(p_slot->command, reply) != M1_SUCCESS_DATA) {
+        return;
+    }
+
+    hash = poll_hash(reply);
+    if (p_slot->report && p_slot->valid && hash == p_slot->hash && ++p_slot->unchanged < p_slot->report)
+        return;
+    p_slot->hash = hash;
+    p_slot->valid = true;
+    p_slot->unchanged = 0;
+    event_batch_publish(reply, EVENT_PRIORITY_BULK);
+}
+
+/******************************************************************************
+* Function Name: poll_register
+* Description  : Registers or clears a polled command. A malformed message,
+*                or a command too long for a slot, leaves the slot cleared.
+* Arguments    : p_message –
+*                    null-terminated registration, starting with
+*                    POLL_MARKER.
+* Return Value : M1_SUCCESS_NO_DATA, M1_ERROR_BAD_HEADER for a malformed
+*                message or M1_ERROR_BUFFER_OVERFLOW for a long command.
+******************************************************************************/
+int poll_register(const char * p_message) {
+    unsigned int slot;
+    unsigned int period_ms;
+    unsigned int report;
+    int n;
+
+    if (sscanf(&p_message[1], "%u;%u;%u;%n", &slot, &period_ms, &report, &n) != 3 || slot >= POLL_SLOTS)
+        return M1_ERROR_BAD_HEADER;
+    poll_slot_t * p_slot = &slots[slot];
+    const char * p_command = &p_message[1 + n];
+
+    p_slot->period = 0;
+    if (period_ms == 0)
+        return M1_SUCCESS_NO_DATA;
+    if (strlen(p_command) >= sizeof(p_slot->command))
+        return M1_ERROR_BUFFER_OVERFLOW;
+    strcpy(p_slot->command, p_command);
+    p_slot->report = report;
+    p_slot->unchanged = 0;
+    p_slot->valid = false;
+    p_slot->due = tx_time_get();
+    p_slot->period = (period_ms / 10 < POLL_PERIOD_MIN) ? POLL_PERIOD_MIN : period_ms / 10;
+    return M1_SUCCESS_NO_DATA;
+}
+
+/******************************************************************************
+* Function Name: poll_run
+* Description  : Runs every registered command which is due.
+* Arguments    : now –
+*                    current tick.
+* Return Value : ticks until the next command is due, TX_WAIT_FOREVER if
+*                none is registered.
+******************************************************************************/
+ULONG poll_run(ULONG now) {
+    ULONG wait = TX_WAIT_FOREVER;
+
+    for (unsigned int i = 0; i < POLL_SLOTS; i++) {
+        poll_slot_t * p_slot = &slots[i];
+
+        if (!p_slot->period)
+            continue;
+        if (now - p_slot->due < 0x80000000UL) {
+            poll_execute(p_slot);
+            p_slot->due += p_slot->period;
+            // a whole period was missed, start a new grid
+            if (now - p_slot->due < 0x80000000UL)
+                p_slot->due = now + p_slot->period;
+        }
+        if (p_slot->due - now < wait)
+            wait = p_slot->due - now;
+    }
+    return wait;
+}
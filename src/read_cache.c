@@ -0,0 +1,349 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : read_cache.c
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Answers repeated cloud driver reads from recent replies
+ *                instead of the bus. I2C read & write commands (3;2) and
+ *                GPIO reads (0;4, the form with a TAG_NAME) are keyed by
+ *                the command without its tag, that is port, command,
+ *                lengths or pin, and the written data, which starts with
+ *                the device address. A reply younger than the command's
+ *                TTL is served again, with its tag changed to the one
+ *                asked for. The TTL is read_cache_ttl (ms), or set per
+ *                command with the prefix
+ *                    C<ttl_ms>;<command>
+ *                where C0; bypasses the cache for commands with side
+ *                effects. read_cache_ttl is 0 by default, so only
+ *                commands with a C<ttl_ms>; prefix are cached until the
+ *                read_cache_ttl setting opts all reads in; clear-on-read
+ *                registers, FIFOs and buttons read by existing rules
+ *                would otherwise see stale values. Any command which returns no data, such as a
+ *                write, flushes the cached replies of its port, so a read
+ *                never returns a value from before a write. The flush is
+ *                done by bus_schedule_command, which every command runs
+ *                through, so it also covers writes in batches, polls and
+ *                on the I2C workers; a read which was under way during a
+ *                flush is not stored. UART reads, batches and polled
+ *                commands are never cached.
+ ******************************************************************************/
+
+#include <app.h>
+#include "tx_api.h"
+#include "read_cache.h"
+#include "bus_schedule.h"
+#include "json_writer.h"
+#include <m1_cloud_driver.h>
+
+#include <stdio.h>
+#include <string.h>
+
+typedef struct read_cache_entry
+{
+    char    key[READ_CACHE_KEY_SIZE];
+    char    tag[READ_CACHE_TAG_SIZE];
+    char    reply[READ_CACHE_REPLY_SIZE];
+    ULONG   stored;     ///< tick the reply was read.
+    bool    valid;
+} read_cache_entry_t;
+
+// default age up to which a reply is served again (ms); 0, the default,
+// caches only commands with a TTL prefix
+int read_cache_ttl = 0;
+
+static TX_MUTEX read_cache_mutex;
+static read_cache_entry_t entries[READ_CACHE_ENTRIES];
+// flushes so far, to tell a read which overlapped a flush
+static uint32_t flushes = 0;
+
+// statistics since the last statistics event
+static uint32_t hits = 0;
+static uint32_t misses = 0;
+static uint32_t bypassed = 0;
+
+/******************************************************************************
+* Function Name: read_cache_key
+* Description  : Splits a cacheable command into its key and tag.
+* Arguments    : p_command –
+*                    null-terminated cloud driver command.
+*                p_key -
+*                    receives the key, READ_CACHE_KEY_SIZE bytes.
+*                p_tag -
+*                    receives the tag, READ_CACHE_TAG_SIZE bytes.
+* Return Value : true if the command can be cached.
+******************************************************************************/
+static bool read_cache_key(const char * p_command, char * p_key, char * p_tag) {
+    unsigned int first;
+    unsigned int second;
+    size_t data_length = 0;
+    int n = 0;
+
+    if (sscanf(p_command, "3;2;%u;%u;%n", &first, &second, &n) == 2 && n)
+        data_length = second;
+    else if (sscanf(p_command, "0;4;%u;%n", &first, &n) != 1 || !n)
+        return false;
+
+    const char * p_name = &p_command[n];
+    const char * p_name_end = strchr(p_name, ';');
+    if (p_name_end == NULL || (size_t)(p_name_end - p_name) >= READ_CACHE_TAG_SIZE ||
+        (size_t)n + data_length >= READ_CACHE_KEY_SIZE || strlen(p_name_end + 1) < data_length)
+        return false;
+    memcpy(p_key, p_command, (size_t)n);
+    memcpy(&p_key[n], p_name_end + 1, data_length);
+    p_key[(size_t)n + data_length] = '\0';
+    memcpy(p_tag, p_name, (size_t)(p_name_end - p_name));
+    p_tag[p_name_end - p_name] = '\0';
+    return true;
+}
+
+/******************************************************************************
+* Function Name: read_cache_retag
+* Description  : Copies a cached reply, replacing its tag.
+* Arguments    : p_entry –
+*                    cache entry.
+*                p_tag -
+*                    tag asked for.
+*                p_reply -
+*                    receives the reply.
+*                size -
+*                    size of p_reply.
+* Return Value : true if the reply was written.
+******************************************************************************/
+static bool read_cache_retag(const read_cache_entry_t * p_entry, const char * p_tag, char * p_reply, size_t size) {
+    char quoted[READ_CACHE_TAG_SIZE + 2];
+    const char * p_found;
+    size_t before;
+    size_t old_length = strlen(p_entry->tag) + 2;
+    size_t tag_length = strlen(p_tag);
+
+    snprintf(quoted, sizeof(quoted), "\"%s\"", p_entry->tag);
+    p_found = strstr(p_entry->reply, quoted);
+    if (p_found == NULL)
+        return false;
+    before = (size_t)(p_found - p_entry->reply);
+    if (strlen(p_entry->reply) - old_length + tag_length + 2 >= size)
+        return false;
+    memcpy(p_reply, p_entry->reply, before);
+    p_reply[before] = '"';
+    memcpy(&p_reply[before + 1], p_tag, tag_length);
+    p_reply[before + 1 + tag_length] = '"';
+    strcpy(&p_reply[before + 2 + tag_length], p_found + old_length);
+    return true;
+}
+
+/******************************************************************************
+* Function Name: read_cache_lookup
+* Description  : Answers a command from a cached reply. Called with the
+*                mutex held.
+* Arguments    : p_key –
+*                    key of the command.
+*                p_tag -
+*                    tag of the command.
+*                ttl -
+*                    oldest reply accepted (ticks).
+*                p_reply -
+*                    receives the reply.
+*                size -
+*                    size of p_reply.
+* Return Value : true on a hit.
+******************************************************************************/
+static bool read_cache_lookup(const char * p_key, const char * p_tag, ULONG ttl, char * p_reply, size_t size) {
+    ULONG now = tx_time_get();
+
+    for (unsigned int i = 0; i < READ_CACHE_ENTRIES; i++) {
+        read_cache_entry_t * p_entry = &entries[i];
+
+        if (!p_entry->valid || now - p_entry->stored >= ttl || strcmp(p_entry->key, p_key))
+            continue;
+        if (!strcmp(p_entry->tag, p_tag)) {
+            if (strlen(p_entry->reply) >= size)
+                return false;
+            strcpy(p_reply, p_entry->reply);
+            return true;
+        }
+        return read_cache_retag(p_entry, p_tag, p_reply, size);
+    }
+    return false;
+}
+
+/******************************************************************************
+* Function Name: read_cache_store
+* Description  : Stores a reply, replacing the entry with the same key, a
+*                free one, or else the oldest one. Called with the mutex
+*                held.
+* Arguments    : p_key –
+*                    key of the command.
+*                p_tag -
+*                    tag of the command.
+*                stored -
+*                    tick the command was started.
+*                p_reply -
+*                    null-terminated reply, shorter than
+*                    READ_CACHE_REPLY_SIZE.
+******************************************************************************/
+static void read_cache_store(const char * p_key, const char * p_tag, ULONG stored, const char * p_reply) {
+    read_cache_entry_t * p_entry = &entries[0];
+    ULONG now = tx_time_get();
+
+    for (unsigned int i = 0; i < READ_CACHE_ENTRIES; i++) {
+        if (entries[i].valid && !strcmp(entries[i].key, p_key)) {
+            p_entry = &entries[i];
+            break;
+        }
+        if (!entries[i].valid)
+            p_entry = &entries[i];
+        else if (p_entry->valid && now - entries[i].stored > now - p_entry->stored)
+            p_entry = &entries[i];
+    }
+    strcpy(p_entry->key, p_key);
+    strcpy(p_entry->tag, p_tag);
+    strcpy(p_entry->reply, p_reply);
+    p_entry->stored = stored;
+    p_entry->valid = true;
+}
+
+/******************************************************************************
+* Function Name: read_cache_flush
+* Description  : Drops the cached replies of a port.
+* Arguments    : port –
+*                    first character of the command.
+******************************************************************************/
+void read_cache_flush(char port) {
+    tx_mutex_get(&read_cache_mutex, TX_WAIT_FOREVER);
+    flushes++;
+    for (unsigned int i = 0; i < READ_CACHE_ENTRIES; i++) {
+        if (entries[i].key[0] == port)
+            entries[i].valid = false;
+    }
+    tx_mutex_put(&read_cache_mutex);
+}
+
+/******************************************************************************
+* Function Name: read_cache_init
+* Description  : Creates the cache mutex. Must be called once, before any
+*                cloud driver command.
+******************************************************************************/
+void read_cache_init(void) {
+    UINT status = tx_mutex_create(&read_cache_mutex, "Read Cache Mutex", TX_NO_INHERIT);
+    APP_ERR_TRAP(status);
+}
+
+/******************************************************************************
+* Function Name: read_cache_command_of
+* Description  : Skips the optional TTL prefix of a message.
+* Arguments    : p_message –
+*                    null-terminated message.
+* Return Value : the cloud driver command.
+******************************************************************************/
+const char * read_cache_command_of(const char * p_message) {
+    const char * p_end;
+
+    if (p_message[0] != READ_CACHE_MARKER || (p_end = strchr(p_message, ';')) == NULL)
+        return p_message;
+    return p_end + 1;
+}
+
+/******************************************************************************
+* Function Name: read_cache_command
+* Description  : Runs a cloud driver command through the cache.
+* Arguments    : p_message –
+*                    null-terminated cloud driver command, with an optional
+*                    TTL prefix.
+*                p_reply -
+*                    buffer for the reply, as for m1_handle_message.
+*                size -
+*                    size of p_reply.
+* Return Value : result of m1_handle_message, or M1_SUCCESS_DATA on a hit.
+******************************************************************************/
+int read_cache_command(const char * p_message, char * p_reply, size_t size) {
+    const char * p_command = read_cache_command_of(p_message);
+    ULONG ttl = (read_cache_ttl > 0) ? (ULONG)read_cache_ttl / 10 : 0;
+    char key[READ_CACHE_KEY_SIZE];
+    char tag[READ_CACHE_TAG_SIZE];
+    ULONG start;
+    uint32_t generation;
+    int status;
+
+    if (p_command != p_message) {
+        unsigned int ttl_ms;
+        if (sscanf(&p_message[1], "%u;", &ttl_ms) != 1)
+            return M1_ERROR_BAD_HEADER;
+        ttl = ttl_ms / 10;
+        if (!ttl) {
+            tx_mutex_get(&read_cache_mutex, TX_WAIT_FOREVER);
+            bypassed++;
+            tx_mutex_put(&read_cache_mutex);
+        }
+    }
+
+    if (!ttl || !read_cache_key(p_command, key, tag))
+        return bus_schedule_command(p_command, p_reply);
+
+    tx_mutex_get(&read_cache_mutex, TX_WAIT_FOREVER);
+    if (read_cache_lookup(key, tag, ttl, p_reply, size)) {
+        hits++;
+        tx_mutex_put(&read_cache_mutex);
+        return M1_SUCCESS_DATA;
+    }
+    misses++;
+    generation = flushes;
+    tx_mutex_put(&read_cache_mutex);
+
+    start = tx_time_get();
+    status = bus_schedule_command(p_command, p_reply);
+    if (status == M1_SUCCESS_DATA && strlen(p_reply) < READ_CACHE_REPLY_SIZE) {
+        tx_mutex_get(&read_cache_mutex, TX_WAIT_FOREVER);
+        // a write during the read may have changed the value
+        if (flushes == generation)
+            read_cache_store(key, tag, start, p_reply);
+        tx_mutex_put(&read_cache_mutex);
+    }
+    return status;
+}
+
+/******************************************************************************
+* Function Name: read_cache_stats
+* Description  : Writes the cache statistics event and starts a new
+*                statistics period.
+* Arguments    : p_buf –
+*                    buffer for the event.
+*                size -
+*                    size of p_buf.
+* Return Value : length of the event, or -1 if it did not fit.
+******************************************************************************/
+int read_cache_stats(char * p_buf, size_t size) {
+    json_writer_t writer;
+
+    tx_mutex_get(&read_cache_mutex, TX_WAIT_FOREVER);
+    json_begin(&writer, p_buf, size);
+    json_key_object(&writer, "read_cache");
+    json_key_uint(&writer, "hits", hits);
+    json_key_uint(&writer, "misses", misses);
+    json_key_uint(&writer, "bypassed", bypassed);
+    json_key_uint(&writer, "hit_pct", (hits + misses) ? hits * 100 / (hits + misses) : 0);
+    json_end_object(&writer);
+    hits = 0;
+    misses = 0;
+    bypassed = 0;
+    tx_mutex_put(&read_cache_mutex);
+    return json_end(&writer);
+}
@@ -0,0 +1,49 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : read_cache.h
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Short-lived cache of cloud driver read replies.
+ ******************************************************************************/
+
+#ifndef READ_CACHE_H_
+#define READ_CACHE_H_
+
+#include <stddef.h>
+
+// first character of the optional C<ttl_ms>; prefix of a command
+#define READ_CACHE_MARKER       'C'
+#define READ_CACHE_ENTRIES      8
+// longest cached key (command without its tag) and reply, with terminators
+#define READ_CACHE_KEY_SIZE     64
+#define READ_CACHE_TAG_SIZE     32
+#define READ_CACHE_REPLY_SIZE   256
+
+extern int read_cache_ttl;
+
+void read_cache_init(void);
+const char * read_cache_command_of(const char * p_message);
+int read_cache_command(const char * p_message, char * p_reply, size_t size);
+void read_cache_flush(char port);
+int read_cache_stats(char * p_buf, size_t size);
+
+#endif /* READ_CACHE_H_ */
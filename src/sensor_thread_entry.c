@@ -30,30 +30,68 @@
 #include "sensor_thread.h"
 #include "lcd_display_api.h"
 #include <m1_agent.h>
+#include "event_batch.h"
+#include "command_pool.h"
+#include "command_batch.h"
+#include "poll.h"
+#include "i2c_worker.h"
+#include "bus_schedule.h"
+#include "read_cache.h"
+#include "chunked_read.h"
+#include "gpio_capture.h"
+#include "uart_stream.h"
+#include "command_trace.h"
+#include "timestamp.h"
 #include <m1_cloud_driver.h>
 
 #include <stdio.h>
+#include <string.h>
 
 void m1_message_callback(int type, char * topic, char * payload, int length);
 void sensor_thread_entry(void);
 
+// longest window the 16-bit vibration sample counter can hold (ms)
+#define WINDOW_MAX_MS 600000
+
 extern int sample_period;
-#ifdef I2C_MULTI_THREAD
-extern TX_QUEUE g_i2c0_queue;
-extern TX_QUEUE g_i2c1_queue;
-#endif
+extern int window_adaptive;
+extern int window_max_period;
+extern int window_tolerance;
+extern int impact_threshold;
+extern int impact_severe;
+extern int impact_refractory;
+extern volatile int calibration_request;
+extern volatile int temp_comp_request;
+extern int mag_gate;
+extern int mag_motor_threshold;
+extern int window_cbor;
+extern int window_deadband;
+extern int window_snapshot;
 
 /******************************************************************************
 * Function Name: sensor_thread_entry
 * Description  : Initializes the comms framework (UART) and pre-configured
 *                I2C devices. Infinitely waits on tx queue for cloud driver
 *                messages and processes them using the M1 Synergy Cloud Driver
-*                library, freeing the message buffer afterward.
+*                library, returning the message buffer to the command pool
+*                afterward. Batches of commands are run by command_batch and
+*                answered with one event, large reads are streamed in parts
+*                by chunked_read, registered commands are run by poll
+*                whenever they are due, and GPIO edges recorded by
+*                gpio_capture or read from the UART by uart_stream are
+*                published in batches. Single commands go through
+*                read_cache; with I2C_MULTI_THREAD, I2C commands are handed
+*                to the worker of their bus (see i2c_worker), and complete
+*                out of order with other commands, but in order on a bus. Replies, chunked read parts and the
+*                answers to registrations carry the request ID of their
+*                message, if any (see command_trace). Every
+*                COMMAND_POOL_STATS_PERIOD the command pool, bus scheduler,
+*                read cache and command latency statistics are published.
 ******************************************************************************/
 void sensor_thread_entry(void)
 {
     ssp_err_t err;
-    char * cloud_driver_command;
+    command_trace_message_t message;
 
     // open PMOD/Grove B as UART(?)
 #if 0
@@ -61,13 +99,13 @@ void sensor_thread_entry(void)
     APP_ERR_TRAP(err);
 #endif
     m1_initialize_comms(&g_sf_comms0);
+    uart_stream_init();
 
     // open PMOD A as I2C (known devices)
 #ifdef I2C_OPEN
     err = g_sf_i2c_device0.p_api->open(g_sf_i2c_device0.p_ctrl, g_sf_i2c_device0.p_cfg);
     APP_ERR_TRAP(err);
     m1_initialize_i2c(&g_sf_i2c_device0);
-#ifndef I2C_MULTI_THREAD
     err = g_sf_i2c_device1.p_api->open(g_sf_i2c_device1.p_ctrl, g_sf_i2c_device1.p_cfg);
     APP_ERR_TRAP(err);
     m1_initialize_i2c(&g_sf_i2c_device1);
@@ -77,60 +115,219 @@ void sensor_thread_entry(void)
     err = g_sf_i2c_device3.p_api->open(g_sf_i2c_device3.p_ctrl, g_sf_i2c_device3.p_cfg);
     APP_ERR_TRAP(err);
     m1_initialize_i2c(&g_sf_i2c_device3);
+    i2c_worker_init();
 #endif
-#endif
+
+    gpio_capture_init();
 
     // we don't open PMOD C because it is used by the vibration thread
 
     // we don't open PMOD D because wifi doesn't share
 
-    char rxBuf[700];
+    char rxBuf[BUS_SCHEDULE_REPLY_SIZE];
+    ULONG stats_tick = tx_time_get() + COMMAND_POOL_STATS_PERIOD;
 
     while (1)
     {
-        tx_queue_receive(&g_cloud_driver_command_queue, &cloud_driver_command, TX_WAIT_FOREVER);
-        if (m1_handle_message(cloud_driver_command, rxBuf) == M1_SUCCESS_DATA)
-            m1_publish_event(rxBuf, NULL);
+        ULONG now = tx_time_get();
+        ULONG wait;
+        ULONG capture_wait;
+
+        if (now - stats_tick < 0x80000000UL) {
+            stats_tick = now + COMMAND_POOL_STATS_PERIOD;
+            if (command_pool_stats(rxBuf, sizeof(rxBuf)) > 0)
+                event_batch_publish(rxBuf, EVENT_PRIORITY_BULK);
+            if (bus_schedule_stats(rxBuf, sizeof(rxBuf)) > 0)
+                event_batch_publish(rxBuf, EVENT_PRIORITY_BULK);
+            if (read_cache_stats(rxBuf, sizeof(rxBuf)) > 0)
+                event_batch_publish(rxBuf, EVENT_PRIORITY_BULK);
+            if (command_trace_stats(rxBuf, sizeof(rxBuf)) > 0)
+                event_batch_publish(rxBuf, EVENT_PRIORITY_BULK);
+        }
+        wait = poll_run(now);
+        capture_wait = gpio_capture_run();
+        if (capture_wait < wait)
+            wait = capture_wait;
+        if (stats_tick - now < wait)
+            wait = stats_tick - now;
+        if (tx_queue_receive(&g_cloud_driver_command_queue, &message, wait) != TX_SUCCESS)
+            continue;
+        command_trace_received();
+        const char * cloud_driver_command = command_trace_command_of(message.p_command);
+        if (cloud_driver_command[0] == POLL_MARKER) {
+            int status = poll_register(cloud_driver_command);
+            command_trace_reply(message.p_command, status, message.queued, rxBuf, sizeof(rxBuf));
+        } else if (cloud_driver_command[0] == UART_STREAM_MARKER) {
+            int status = uart_stream_register(cloud_driver_command);
+            command_trace_reply(message.p_command, status, message.queued, rxBuf, sizeof(rxBuf));
+        } else if (cloud_driver_command[0] == GPIO_CAPTURE_MARKER) {
+            int status = gpio_capture_register(cloud_driver_command);
+            command_trace_reply(message.p_command, status, message.queued, rxBuf, sizeof(rxBuf));
+        } else if (cloud_driver_command[0] == CHUNKED_READ_MARKER) {
+            i2c_worker_drain();
+            chunked_read_run(message.p_command);
+        } else if (cloud_driver_command[0] == COMMAND_BATCH_MARKER) {
+            i2c_worker_drain();
+            if (command_batch_run(cloud_driver_command, rxBuf, sizeof(rxBuf)) > 0) {
+                command_trace_id(message.p_command, rxBuf, sizeof(rxBuf));
+                event_batch_publish(rxBuf, EVENT_PRIORITY_REPLY);
+            }
+        } else if (i2c_worker_dispatch(message.p_command, message.queued)) {
+            // the worker completes the command and frees the buffer
+            continue;
+        } else {
+            // I2C commands keep their order with the ones on the workers
+            if (strncmp(read_cache_command_of(cloud_driver_command), "3;", 2) == 0)
+                i2c_worker_drain();
+            int status = read_cache_command(cloud_driver_command, rxBuf, sizeof(rxBuf));
+            command_trace_reply(message.p_command, status, message.queued, rxBuf, sizeof(rxBuf));
+        }
 
-        free(cloud_driver_command);
+        command_trace_done(message.queued);
+        command_pool_free(message.p_command);
     }
 }
 
 extern const sf_message_instance_t g_sf_message0;
 
+/******************************************************************************
+* Function Name: setting_parse
+* Description  : Matches a settings update of the form <name><value> and
+*                parses the integer value.
+* Arguments    : setting –
+*                    null-terminated settings string (without the 'S').
+*                name -
+*                    name of the setting to match.
+*                value -
+*                    receives the parsed value.
+* Return Value : 1 if the setting matched and the value was parsed, else 0.
+******************************************************************************/
+static int setting_parse(const char * setting, const char * name, int * value) {
+    size_t name_len = strlen(name);
+
+    if (strncmp(setting, name, name_len))
+        return 0;
+    return sscanf(&setting[name_len], "%d", value) == 1;
+}
+
 /******************************************************************************
 * Function Name: m1_message_callback
 * Description  : Callback routine to handle messages published to subscribed
 *                topic. This routine is called by the M1 VSA thread.
 *                3 different types of messages can be handled in this routine:
 *                    1. Settings update. Messages starting with 'S' are
-*                       interpreted as settings update, which can adjust the
-*                       global int sample_period
-*                       (see vibration_detection_thread).
+*                       interpreted as settings update of the form
+*                       <name><value>, which can adjust the vibration
+*                       thread (see vibration_detection_thread):
+*                           vibration_window - sample_period (ms)
+*                           vibration_window_adaptive - 0 or 1
+*                           vibration_window_max - window_max_period (ms)
+*                           vibration_window_tolerance - energy band (%)
+*                           vibration_impact_threshold - impact jerk (mg)
+*                           vibration_impact_severe - severe impact (mg)
+*                           vibration_impact_refractory - impact hold (ms)
+*                           vibration_calibrate - 0..5 capture orientation
+*                                                 (+X, -X, +Y, -Y, +Z, -Z up),
+*                                                 6 solve and store, -1 erase
+*                           vibration_temp_comp - 1 on, 0 off, -1 clear
+*                           vibration_mag_gate - 0 or 1, skip vibration
+*                                                analysis while motor is off
+*                           vibration_mag_motor - motor field range (uT)
+*                           vibration_cbor - 1 for CBOR window events
+*                           vibration_deadband - window field deadband (%),
+*                                                0 sends every field
+*                           vibration_snapshot - full window event every
+*                                                N windows
+*                       and the outbound event batching (see event_batch):
+*                           event_batch_age - longest event wait (ms)
+*                           event_batch_size - flush size (bytes)
+*                       and the cloud driver read cache (see read_cache):
+*                           read_cache_ttl - reply reuse age (ms), 0 off
 *                    2. Display command. Messages starting with 'D' are
 *                       interpreted as commands to display strings to the LCD.
 *                       A message framework is used to post the string to the
 *                       GUI thread.
 *                    3. All other messages are assumed to be cloud driver
-*                       commands. Buffers to hold the message are malloc'd and
-*                       sent to the TX_QUEUE which the sensor thread is
-*                       listening on.
+*                       commands, batches of them starting with 'B' (see
+*                       command_batch), commands to run periodically
+*                       starting with 'P' (see poll), commands with a read
+*                       cache TTL prefix starting with 'C' (see read_cache),
+*                       large reads starting with 'L' (see chunked_read),
+*                       GPIO edge capture settings starting with 'G' (see
+*                       gpio_capture), or UART stream settings starting
+*                       with 'U' (see uart_stream). Any of them may start
+*                       with a request ID prefix 'R<id>;' which is echoed
+*                       in the reply (see command_trace). The message is
+*                       copied, null-terminated, into a command pool buffer
+*                       which is sent, with its time stamp, to the
+*                       TX_QUEUE which the sensor thread is listening on.
+*                       The sensor thread then owns the buffer. A message
+*                       which gets no buffer or finds the queue full is
+*                       answered with an error (see command_trace_refused).
 * Arguments    : See M1 VSA documentation
 ******************************************************************************/
 void m1_message_callback(int type, char * topic, char * payload, int length) {
     int ret;
     ssp_err_t err;
-    int updated_sample_period;
+    int updated_value;
     SSP_PARAMETER_NOT_USED(type);
     SSP_PARAMETER_NOT_USED(topic);
 
     switch (payload[0]) {
         case 'S': {
             // this is a settings update
-            if (!strncmp(&payload[1], "vibration_window", (((size_t)length) < strlen("vibration_window")) ? (size_t)length : strlen("vibration_window"))) {
-                ret = sscanf(&payload[1 + strlen("vibration_window")], "%d", &updated_sample_period);
-                if (ret == 1)
-                    sample_period = updated_sample_period / 10;
+            char setting[64];
+            size_t setting_len = ((size_t)length - 1 < sizeof(setting) - 1) ? (size_t)length - 1 : sizeof(setting) - 1;
+            memcpy(setting, &payload[1], setting_len);
+            setting[setting_len] = '\0';
+            if (setting_parse(setting, "vibration_window_adaptive", &updated_value)) {
+                window_adaptive = updated_value;
+            } else if (setting_parse(setting, "vibration_window_max", &updated_value)) {
+                if (updated_value > WINDOW_MAX_MS)
+                    updated_value = WINDOW_MAX_MS;
+                window_max_period = updated_value / 10;
+            } else if (setting_parse(setting, "vibration_window_tolerance", &updated_value)) {
+                if (updated_value >= 0)
+                    window_tolerance = updated_value;
+            } else if (setting_parse(setting, "vibration_impact_threshold", &updated_value)) {
+                if (updated_value > 0)
+                    impact_threshold = updated_value;
+            } else if (setting_parse(setting, "vibration_impact_severe", &updated_value)) {
+                if (updated_value > 0)
+                    impact_severe = updated_value;
+            } else if (setting_parse(setting, "vibration_impact_refractory", &updated_value)) {
+                if (updated_value >= 0)
+                    impact_refractory = updated_value / 10;
+            } else if (setting_parse(setting, "vibration_calibrate", &updated_value)) {
+                calibration_request = updated_value;
+            } else if (setting_parse(setting, "vibration_temp_comp", &updated_value)) {
+                temp_comp_request = updated_value;
+            } else if (setting_parse(setting, "vibration_mag_gate", &updated_value)) {
+                mag_gate = updated_value;
+            } else if (setting_parse(setting, "vibration_mag_motor", &updated_value)) {
+                if (updated_value >= 0)
+                    mag_motor_threshold = updated_value;
+            } else if (setting_parse(setting, "vibration_cbor", &updated_value)) {
+                window_cbor = updated_value;
+            } else if (setting_parse(setting, "vibration_deadband", &updated_value)) {
+                if (updated_value >= 0)
+                    window_deadband = updated_value;
+            } else if (setting_parse(setting, "vibration_snapshot", &updated_value)) {
+                if (updated_value > 0)
+                    window_snapshot = updated_value;
+            } else if (setting_parse(setting, "event_batch_age", &updated_value)) {
+                if (updated_value >= 0)
+                    event_batch_max_age = updated_value;
+            } else if (setting_parse(setting, "event_batch_size", &updated_value)) {
+                if (updated_value > 0)
+                    event_batch_flush_size = updated_value;
+            } else if (setting_parse(setting, "read_cache_ttl", &updated_value)) {
+                if (updated_value >= 0)
+                    read_cache_ttl = updated_value;
+            } else if (setting_parse(setting, "vibration_window", &updated_value)) {
+                if (updated_value > WINDOW_MAX_MS)
+                    updated_value = WINDOW_MAX_MS;
+                sample_period = updated_value / 10;
             }
             break;
         } case 'D': {
@@ -166,15 +363,24 @@ void m1_message_callback(int type, char * topic, char * payload, int length) {
             break;
         } default: {
 
-            char * newBuf = (char *)malloc((size_t)length);
-            if (newBuf != NULL) {
-                memcpy(newBuf, payload, (size_t)length);
-                err = tx_queue_send(&g_cloud_driver_command_queue, &newBuf, 20);
-                if (err) {
-                    if (err != TX_QUEUE_FULL)
-                        APP_ERR_TRAP(err);
-                    free(newBuf);
-                }
+            command_trace_message_t message;
+            message.p_command = command_pool_alloc((size_t)length + 1);
+            if (message.p_command == NULL) {
+                command_trace_refused(payload, (size_t)length,
+                                      ((size_t)length + 1 > COMMAND_POOL_LARGE_SIZE) ? "length" : "pool");
+                break;
+            }
+            memcpy(message.p_command, payload, (size_t)length);
+            message.p_command[length] = '\0';
+            message.queued = timestamp_us();
+            err = tx_queue_send(&g_cloud_driver_command_queue, &message, 20);
+            if (err) {
+                if (err != TX_QUEUE_FULL)
+                    APP_ERR_TRAP(err);
+                command_pool_free(message.p_command);
+                command_trace_refused(payload, (size_t)length, "queue");
+            } else {
+                command_trace_queued();
             }
             break;
         }
@@ -0,0 +1,52 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : store_flash.h
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : NOR flash operations used by the persistent event store.
+ *                Kept free of SSP and ThreadX types so the store can also
+ *                run against a file-backed stand-in on a host.
+ ******************************************************************************/
+
+#ifndef STORE_FLASH_H_
+#define STORE_FLASH_H_
+
+#include <stdint.h>
+
+typedef struct store_flash
+{
+    uint32_t    size;           ///< bytes in the region, a multiple of sector_size.
+    uint32_t    sector_size;    ///< erase unit.
+    uint32_t    page_size;      ///< a program may not cross a page boundary.
+    /** Reads length bytes at offset. Returns 0 on success. */
+    int (* read)(uint32_t offset, void * p_dest, uint32_t length);
+    /** Programs length bytes within one page, only clearing bits. Returns 0 on success. */
+    int (* program)(uint32_t offset, const void * p_src, uint32_t length);
+    /** Erases the sector starting at offset to all ones. Returns 0 on success. */
+    int (* erase)(uint32_t offset);
+} store_flash_t;
+
+extern const store_flash_t store_flash_qspi;
+
+int store_flash_qspi_open(void);
+
+#endif /* STORE_FLASH_H_ */
@@ -0,0 +1,120 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : store_flash_qspi.c
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : store_flash operations on the last megabyte of the QSPI
+ *                flash the driver can address, which is not used by the
+ *                linker script sections. The board's N25Q256A holds 32 MB,
+ *                but the BSP runs it with 3-byte addresses, so only the
+ *                first 16 MB are reachable; the 64 MB memory-mapped window
+ *                of the linker script repeats them.
+ *                Reads go through the memory-mapped window, programs and
+ *                erases through g_qspi0 and poll until the device is done.
+ ******************************************************************************/
+
+#include <app.h>
+#include "net_thread.h"
+#include "store_flash.h"
+
+#include <string.h>
+
+#define QSPI_BASE_ADDRESS       0x60000000
+// reachable with 3-byte addresses (BSP_PRV_QSPI_NUM_ADDRESS_BYTES)
+#define QSPI_SIZE               0x1000000
+#define QSPI_STORE_SIZE         0x100000
+#define QSPI_STORE_ADDRESS      (QSPI_BASE_ADDRESS + QSPI_SIZE - QSPI_STORE_SIZE)
+#define QSPI_SECTOR_SIZE        4096
+#define QSPI_PAGE_SIZE          256
+
+static int qspi_read(uint32_t offset, void * p_dest, uint32_t length);
+static int qspi_program(uint32_t offset, const void * p_src, uint32_t length);
+static int qspi_erase(uint32_t offset);
+
+const store_flash_t store_flash_qspi =
+{
+    .size = QSPI_STORE_SIZE,
+    .sector_size = QSPI_SECTOR_SIZE,
+    .page_size = QSPI_PAGE_SIZE,
+    .read = qspi_read,
+    .program = qspi_program,
+    .erase = qspi_erase,
+};
+
+/******************************************************************************
+* Function Name: qspi_wait
+* Description  : Waits for a program or erase to complete.
+* Arguments    : sleep –
+*                    ticks to sleep between polls, 0 to spin.
+* Return Value : 0 on success, -1 on a driver error.
+******************************************************************************/
+static int qspi_wait(ULONG sleep) {
+    bool busy = true;
+
+    while (busy) {
+        if (g_qspi0.p_api->statusGet(g_qspi0.p_ctrl, &busy) != SSP_SUCCESS)
+            return -1;
+        if (busy && sleep)
+            tx_thread_sleep(sleep);
+    }
+    return 0;
+}
+
+/******************************************************************************
+* Function Name: store_flash_qspi_open
+* Description  : Opens the QSPI driver. Must be called before the store is
+*                used.
+* Return Value : 0 on success, -1 on a driver error.
+******************************************************************************/
+int store_flash_qspi_open(void) {
+    return (g_qspi0.p_api->open(g_qspi0.p_ctrl, g_qspi0.p_cfg) == SSP_SUCCESS) ? 0 : -1;
+}
+
+/******************************************************************************
+* Function Name: qspi_read
+* Description  : See store_flash_t.
+******************************************************************************/
+static int qspi_read(uint32_t offset, void * p_dest, uint32_t length) {
+    memcpy(p_dest, (const void *)(QSPI_STORE_ADDRESS + offset), length);
+    return 0;
+}
+
+/******************************************************************************
+* Function Name: qspi_program
+* Description  : See store_flash_t.
+******************************************************************************/
+static int qspi_program(uint32_t offset, const void * p_src, uint32_t length) {
+    if (g_qspi0.p_api->pageProgram(g_qspi0.p_ctrl, (uint8_t *)(QSPI_STORE_ADDRESS + offset),
+                                   (uint8_t *)p_src, length) != SSP_SUCCESS)
+        return -1;
+    return qspi_wait(0);
+}
+
+/******************************************************************************
+* Function Name: qspi_erase
+* Description  : See store_flash_t.
+******************************************************************************/
+static int qspi_erase(uint32_t offset) {
+    if (g_qspi0.p_api->sectorErase(g_qspi0.p_ctrl, (uint8_t *)(QSPI_STORE_ADDRESS + offset)) != SSP_SUCCESS)
+        return -1;
+    return qspi_wait(1);
+}
@@ -0,0 +1,138 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : temp_compensation.c
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Learns how the accelerometer offset drifts with die
+ *                temperature. Whenever a window closes with the board at
+ *                rest, the uncompensated average is compared with the
+ *                reference average taken at the first rest window, and the
+ *                difference is filtered into the bin for the current
+ *                temperature. The offset of the current bin is subtracted
+ *                from the calibration offset, so compensation costs nothing
+ *                per sample.
+ ******************************************************************************/
+
+#include <app.h>
+#include "temp_compensation.h"
+
+#include <string.h>
+
+typedef struct temp_comp_bin
+{
+    float       offset[3];
+    uint16_t    count;
+} temp_comp_bin_t;
+
+static temp_comp_bin_t bins[TEMP_COMP_BINS];
+static float reference[3];
+static bool reference_valid = false;
+static float applied_offset[3];
+
+/******************************************************************************
+* Function Name: temp_comp_bin
+* Description  : Maps a temperature to its table bin.
+* Arguments    : temp_c –
+*                    temperature in degrees C.
+* Return Value : Bin index, clamped to the table.
+******************************************************************************/
+static int temp_comp_bin(float temp_c) {
+    int bin = ((int)temp_c - TEMP_COMP_MIN_C) / TEMP_COMP_STEP_C;
+
+    if (bin < 0)
+        return 0;
+    if (bin >= TEMP_COMP_BINS)
+        return TEMP_COMP_BINS - 1;
+    return bin;
+}
+
+/******************************************************************************
+* Function Name: temp_comp_reset
+* Description  : Forgets the learned table and reference.
+******************************************************************************/
+void temp_comp_reset(void) {
+    memset(bins, 0, sizeof(bins));
+    reference_valid = false;
+}
+
+/******************************************************************************
+* Function Name: temp_comp_apply
+* Description  : Builds the transform used in the sample path: the
+*                calibration transform with the learned offset for temp_c
+*                removed. Called whenever the temperature or the calibration
+*                changes.
+* Arguments    : p_transform –
+*                    calibration transform.
+*                temp_c -
+*                    current temperature in degrees C.
+*                enabled -
+*                    false to apply no compensation.
+*                p_applied -
+*                    receives the compensated transform.
+******************************************************************************/
+void temp_comp_apply(const accel_transform_t * p_transform, float temp_c, bool enabled, accel_transform_t * p_applied) {
+    const temp_comp_bin_t * p_bin = &bins[temp_comp_bin(temp_c)];
+
+    *p_applied = *p_transform;
+    for (int i = 0; i < 3; i++) {
+        applied_offset[i] = (enabled && p_bin->count) ? p_bin->offset[i] : 0;
+        p_applied->offset[i] -= applied_offset[i];
+    }
+}
+
+/******************************************************************************
+* Function Name: temp_comp_learn
+* Description  : Feeds the averages of a window taken at rest into the table.
+* Arguments    : temp_c –
+*                    temperature in degrees C during the window.
+*                x_avg, y_avg, z_avg -
+*                    compensated window averages in g.
+******************************************************************************/
+void temp_comp_learn(float temp_c, float x_avg, float y_avg, float z_avg) {
+    float avg[3];
+    float drift[3];
+    temp_comp_bin_t * p_bin = &bins[temp_comp_bin(temp_c)];
+
+    avg[0] = x_avg + applied_offset[0];
+    avg[1] = y_avg + applied_offset[1];
+    avg[2] = z_avg + applied_offset[2];
+    if (!reference_valid) {
+        memcpy(reference, avg, sizeof(reference));
+        reference_valid = true;
+    }
+    for (int i = 0; i < 3; i++) {
+        drift[i] = avg[i] - reference[i];
+        if (drift[i] > TEMP_COMP_MAX_DRIFT || drift[i] < -TEMP_COMP_MAX_DRIFT) {
+            // the board was moved, start over in the new position
+            temp_comp_reset();
+            return;
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        if (p_bin->count == 0)
+            p_bin->offset[i] = drift[i];
+        else
+            p_bin->offset[i] += (drift[i] - p_bin->offset[i]) / 8;
+    }
+    if (p_bin->count < UINT16_MAX)
+        p_bin->count++;
+}
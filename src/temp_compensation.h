@@ -0,0 +1,47 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : temp_compensation.h
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Temperature-to-offset compensation table for the
+ *                accelerometer.
+ ******************************************************************************/
+
+#ifndef TEMP_COMPENSATION_H_
+#define TEMP_COMPENSATION_H_
+
+#include "accel_calibration.h"
+
+#define TEMP_COMP_MIN_C     (-10)
+#define TEMP_COMP_STEP_C    5
+#define TEMP_COMP_BINS      20
+
+// largest window energy (g^2) at which the board is considered at rest
+#define TEMP_COMP_LEARN_ENERGY  0.0001f
+// larger drifts (g) are taken as the board having been moved
+#define TEMP_COMP_MAX_DRIFT     0.05f
+
+void temp_comp_reset(void);
+void temp_comp_apply(const accel_transform_t * p_transform, float temp_c, bool enabled, accel_transform_t * p_applied);
+void temp_comp_learn(float temp_c, float x_avg, float y_avg, float z_avg);
+
+#endif /* TEMP_COMPENSATION_H_ */
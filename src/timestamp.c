@@ -0,0 +1,101 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : timestamp.c
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : One clock for everything that measures time: boot
+ *                milestones, command latency, the bus scheduler and GPIO
+ *                edge capture. timestamp_us counts microseconds since the
+ *                kernel started, from the DWT cycle counter. The counter
+ *                wraps after about 89 s at 48 MHz, so each call keeps the
+ *                tick and cycle count it was made at, and the tick count
+ *                since the previous call tells how often the counter
+ *                wrapped in between. The time stamp itself wraps after
+ *                about 71 minutes; intervals are taken by unsigned
+ *                subtraction and are exact up to that length. Callable
+ *                from threads and interrupts, and before any
+ *                initialization: the first call starts the cycle counter.
+ ******************************************************************************/
+
+#include <app.h>
+#include "tx_api.h"
+#include "timestamp.h"
+
+// ThreadX tick (us)
+#define TIMESTAMP_TICK_US       10000
+// below this many ticks since the previous call the cycle counter cannot
+// have wrapped, with margin for the tick resolution
+#define TIMESTAMP_WRAP_TICKS    (60 * 100)
+
+static bool started = false;
+static uint32_t cycles_per_us;
+static uint32_t cycles_per_tick;
+// tick, cycle count and time stamp of the previous call
+static ULONG last_tick;
+static uint32_t last_cycles;
+static uint32_t last_us;
+
+/******************************************************************************
+* Function Name: timestamp_us
+* Description  : Reads the shared clock.
+* Return Value : microseconds since the kernel started, modulo 2^32.
+******************************************************************************/
+uint32_t timestamp_us(void) {
+    TX_INTERRUPT_SAVE_AREA
+    uint32_t elapsed_us;
+    uint32_t remainder;
+    uint32_t now;
+
+    TX_DISABLE
+    if (!started) {
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+        cycles_per_us = SystemCoreClock / 1000000;
+        cycles_per_tick = SystemCoreClock / (1000000 / TIMESTAMP_TICK_US);
+        last_tick = tx_time_get();
+        last_cycles = DWT->CYCCNT;
+        last_us = (uint32_t)last_tick * TIMESTAMP_TICK_US;
+        started = true;
+    }
+    ULONG tick = tx_time_get();
+    uint32_t cycles = DWT->CYCCNT;
+    uint32_t elapsed = cycles - last_cycles;
+    ULONG ticks = tick - last_tick;
+
+    if (ticks < TIMESTAMP_WRAP_TICKS) {
+        elapsed_us = elapsed / cycles_per_us;
+        remainder = elapsed % cycles_per_us;
+    } else {
+        // the wraps which bring the cycle count closest to the tick count
+        int64_t behind = (int64_t)ticks * cycles_per_tick - elapsed;
+        uint64_t total = elapsed + ((uint64_t)((behind + 0x80000000LL) >> 32) << 32);
+        elapsed_us = (uint32_t)(total / cycles_per_us);
+        remainder = (uint32_t)(total % cycles_per_us);
+    }
+    // the part of a microsecond left over counts towards the next call
+    last_tick = tick;
+    last_cycles = cycles - remainder;
+    last_us += elapsed_us;
+    now = last_us;
+    TX_RESTORE
+    return now;
+}
@@ -0,0 +1,308 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : uart_stream.c
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Reads a serial sensor on the cloud driver UART continuously,
+ *                instead of the cloud requesting fixed-length reads. A
+ *                stream is started with
+ *                    U<mode>;<param>;<batch_bytes>;<batch_ms>;<tag>
+ *                where <mode> is UART_STREAM_DELIMITED, with <param> the
+ *                delimiter byte (10 for lines), or UART_STREAM_FIXED, with
+ *                <param> the frame length; U0 stops it. The stream thread
+ *                takes the received bytes from the comms framework, whose
+ *                receive interrupt queues them, and cuts them into frames.
+ *                Frames are collected until the event would exceed
+ *                <batch_bytes> (at most UART_STREAM_BATCH_MAX) or the first
+ *                one is <batch_ms> old, then published as a bulk event
+ *                    {"<tag>":"<frames>","uart_stream":{"seq":<n>,
+ *                     "frames":<n>,"dropped":<n>}}
+ *                with delimited frames as text joined by newlines, and
+ *                fixed frames as hex joined by commas. Frames too long,
+ *                delimited frames holding a NUL byte, which would end the
+ *                text, and frames lost to a full event queue are counted
+ *                as dropped. Cloud
+ *                driver UART commands hold the UART between reads (see
+ *                uart_stream_hold), so they still work but take the bytes
+ *                they read from the stream.
+ ******************************************************************************/
+
+#include <app.h>
+#include "tx_api.h"
+#include "sensor_thread.h"
+#include "uart_stream.h"
+#include "event_batch.h"
+#include "json_writer.h"
+#include <m1_cloud_driver.h>
+
+#include <stdio.h>
+#include <string.h>
+
+// uart_stream_flags
+#define UART_STREAM_START_FLAG  0x01
+
+static TX_THREAD uart_stream_thread;
+static ULONG uart_stream_stack[UART_STREAM_STACK_SIZE / sizeof(ULONG)];
+// held by the stream thread while it reads or changes the stream
+static TX_MUTEX uart_stream_mutex;
+static TX_EVENT_FLAGS_GROUP uart_stream_flags;
+
+// stream settings
+static uint32_t mode = UART_STREAM_OFF;
+static uint32_t param;
+static uint32_t batch_limit;
+static ULONG batch_age;
+static char tag[UART_STREAM_TAG_MAX];
+
+static uint8_t frame[UART_STREAM_FRAME_MAX];
+static uint32_t frame_length = 0;
+static bool overlong = false;
+
+// frames not yet published, with their size as JSON text
+static char batch[UART_STREAM_BATCH_MAX + 1];
+static uint32_t batch_length = 0;
+static uint32_t batch_cost = 0;
+static uint32_t batch_frames = 0;
+static ULONG batch_start;
+static char event[UART_STREAM_BATCH_MAX + UART_STREAM_TAG_MAX + 96];
+
+// event sequence number, and frames dropped since the last event
+static uint32_t seq = 0;
+static uint32_t dropped = 0;
+
+/******************************************************************************
+* Function Name: uart_stream_flush
+* Description  : Publishes the collected frames.
+******************************************************************************/
+static void uart_stream_flush(void) {
+    json_writer_t writer;
+
+    if (!batch_frames)
+        return;
+    batch[batch_length] = '\0';
+    json_begin(&writer, event, sizeof(event));
+    json_key_string(&writer, tag, batch);
+    json_key_object(&writer, "uart_stream");
+    json_key_uint(&writer, "seq", seq++);
+    json_key_uint(&writer, "frames", batch_frames);
+    json_key_uint(&writer, "dropped", dropped);
+    json_end_object(&writer);
+    if (json_end(&writer) <= 0 || event_batch_publish(event, EVENT_PRIORITY_BULK))
+        dropped += batch_frames;
+    else
+        dropped = 0;
+    batch_length = 0;
+    batch_cost = 0;
+    batch_frames = 0;
+}
+
+/******************************************************************************
+* Function Name: uart_stream_frame
+* Description  : Adds a complete frame to the batch, publishing the batch
+*                first if the frame would not fit. A delimited frame with a
+*                NUL byte is dropped, as the batch is a C string.
+******************************************************************************/
+static void uart_stream_frame(void) {
+    static const char hex[] = "0123456789abcdef";
+    uint32_t cost = 0;
+
+    // as escaped by json_key_string, with the separator
+    if (mode == UART_STREAM_FIXED) {
+        cost = 2 * frame_length + 1;
+    } else {
+        for (uint32_t i = 0; i < frame_length; i++) {
+            if (frame[i] == 0) {
+                dropped++;
+                return;
+            }
+            cost += (frame[i] < 0x20) ? 6u : (frame[i] == '"' || frame[i] == '\\') ? 2u : 1u;
+        }
+        cost += 6;
+    }
+    if (batch_frames && batch_cost + cost > batch_limit)
+        uart_stream_flush();
+    if (cost > UART_STREAM_BATCH_MAX) {
+        dropped++;
+        return;
+    }
+    if (!batch_frames) {
+        batch_start = tx_time_get();
+    } else {
+        batch[batch_length++] = (mode == UART_STREAM_FIXED) ? ',' : '\n';
+    }
+    for (uint32_t i = 0; i < frame_length; i++) {
+        if (mode == UART_STREAM_FIXED) {
+            batch[batch_length++] = hex[frame[i] >> 4];
+            batch[batch_length++] = hex[frame[i] & 0x0f];
+        } else {
+            batch[batch_length++] = (char)frame[i];
+        }
+    }
+    batch_cost += cost;
+    batch_frames++;
+    if (batch_cost >= batch_limit)
+        uart_stream_flush();
+}
+
+/******************************************************************************
+* Function Name: uart_stream_byte
+* Description  : Adds a received byte to the current frame.
+* Arguments    : byte –
+*                    received byte.
+******************************************************************************/
+static void uart_stream_byte(uint8_t byte) {
+    if (mode == UART_STREAM_DELIMITED && byte == param) {
+        if (overlong)
+            dropped++;
+        else
+            uart_stream_frame();
+        frame_length = 0;
+        overlong = false;
+        return;
+    }
+    if (frame_length >= UART_STREAM_FRAME_MAX) {
+        overlong = true;
+        return;
+    }
+    frame[frame_length++] = byte;
+    if (mode == UART_STREAM_FIXED && frame_length == param) {
+        uart_stream_frame();
+        frame_length = 0;
+    }
+}
+
+/******************************************************************************
+* Function Name: uart_stream_entry
+* Description  : Stream thread. Waits for a stream to be started, then reads
+*                it byte by byte and publishes its batches when they are
+*                full or old enough.
+* Arguments    : arg –
+*                    not used.
+******************************************************************************/
+static void uart_stream_entry(ULONG arg) {
+    ULONG actual;
+    uint8_t byte;
+    SSP_PARAMETER_NOT_USED(arg);
+
+    while (1) {
+        tx_mutex_get(&uart_stream_mutex, TX_WAIT_FOREVER);
+        if (mode == UART_STREAM_OFF) {
+            tx_mutex_put(&uart_stream_mutex);
+            tx_event_flags_get(&uart_stream_flags, UART_STREAM_START_FLAG, TX_OR_CLEAR, &actual, TX_WAIT_FOREVER);
+            continue;
+        }
+
+        UINT wait = UART_STREAM_READ_WAIT;
+        if (batch_frames) {
+            ULONG age = tx_time_get() - batch_start;
+            if (age >= batch_age)
+                uart_stream_flush();
+            else if (batch_age - age < wait)
+                wait = (UINT)(batch_age - age);
+        }
+        if (g_sf_comms0.p_api->read(g_sf_comms0.p_ctrl, &byte, 1, wait) == SSP_SUCCESS)
+            uart_stream_byte(byte);
+        tx_mutex_put(&uart_stream_mutex);
+    }
+}
+
+/******************************************************************************
+* Function Name: uart_stream_init
+* Description  : Creates the stream thread, stopped. Must be called once,
+*                after the comms framework is registered with the cloud
+*                driver.
+******************************************************************************/
+void uart_stream_init(void) {
+    UINT status = tx_mutex_create(&uart_stream_mutex, "UART Stream Mutex", TX_NO_INHERIT);
+    APP_ERR_TRAP(status);
+    status = tx_event_flags_create(&uart_stream_flags, "UART Stream Flags");
+    APP_ERR_TRAP(status);
+    status = tx_thread_create(&uart_stream_thread, "UART Stream Thread", uart_stream_entry, 0,
+                              uart_stream_stack, sizeof(uart_stream_stack), UART_STREAM_PRIORITY,
+                              UART_STREAM_PRIORITY, 1, TX_AUTO_START);
+    APP_ERR_TRAP(status);
+}
+
+/******************************************************************************
+* Function Name: uart_stream_register
+* Description  : Starts, changes or stops the stream. Frames of the previous
+*                stream are published first. A malformed message stops the
+*                stream.
+* Arguments    : p_message –
+*                    null-terminated stream message, starting with
+*                    UART_STREAM_MARKER.
+* Return Value : M1_SUCCESS_NO_DATA, or M1_ERROR_BAD_COMMAND for a
+*                malformed message.
+******************************************************************************/
+int uart_stream_register(const char * p_message) {
+    unsigned int new_mode;
+    unsigned int new_param = 0;
+    unsigned int batch_bytes = 0;
+    unsigned int batch_ms = 0;
+    int n = 0;
+    int status = M1_SUCCESS_NO_DATA;
+
+    int fields = sscanf(&p_message[1], "%u;%u;%u;%u;%n", &new_mode, &new_param, &batch_bytes, &batch_ms, &n);
+    const char * p_tag = &p_message[1 + n];
+    if (fields != 4 || !n || !*p_tag || strlen(p_tag) >= sizeof(tag) ||
+        (new_mode == UART_STREAM_DELIMITED && new_param > 0xff) ||
+        (new_mode == UART_STREAM_FIXED && (new_param == 0 || new_param > UART_STREAM_FRAME_MAX)) ||
+        new_mode > UART_STREAM_FIXED) {
+        // U0; with or without the rest is a plain stop
+        if (fields < 1 || new_mode != UART_STREAM_OFF)
+            status = M1_ERROR_BAD_COMMAND;
+        new_mode = UART_STREAM_OFF;
+    }
+
+    tx_mutex_get(&uart_stream_mutex, TX_WAIT_FOREVER);
+    uart_stream_flush();
+    frame_length = 0;
+    overlong = false;
+    mode = new_mode;
+    if (mode != UART_STREAM_OFF) {
+        param = new_param;
+        batch_limit = (batch_bytes == 0 || batch_bytes > UART_STREAM_BATCH_MAX) ? UART_STREAM_BATCH_MAX : batch_bytes;
+        batch_age = batch_ms / 10;
+        strcpy(tag, p_tag);
+        tx_event_flags_set(&uart_stream_flags, UART_STREAM_START_FLAG, TX_OR);
+    }
+    tx_mutex_put(&uart_stream_mutex);
+    return status;
+}
+
+/******************************************************************************
+* Function Name: uart_stream_hold
+* Description  : Takes the UART from the stream for a cloud driver command,
+*                waiting at most UART_STREAM_READ_WAIT for the current read.
+*                Must be followed by uart_stream_release.
+******************************************************************************/
+void uart_stream_hold(void) {
+    tx_mutex_get(&uart_stream_mutex, TX_WAIT_FOREVER);
+}
+
+/******************************************************************************
+* Function Name: uart_stream_release
+* Description  : Gives the UART back to the stream.
+******************************************************************************/
+void uart_stream_release(void) {
+    tx_mutex_put(&uart_stream_mutex);
+}
@@ -0,0 +1,56 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : uart_stream.h
+ * Version      : 1.0
+ * Device(s)    : S3A7
+ * Tool-Chain   : e2studio, GNU GCC 4.9
+ * OS           : ThreadX
+ * H/W Platform : S3A7 IoT Enabler
+ * Description  : Background ingestion of a serial sensor stream on the cloud
+ *                driver UART.
+ ******************************************************************************/
+
+#ifndef UART_STREAM_H_
+#define UART_STREAM_H_
+
+// first character of a stream message
+#define UART_STREAM_MARKER      'U'
+// longest frame (bytes), longer delimited frames are dropped
+#define UART_STREAM_FRAME_MAX   128
+// frames of one event, as text or hex
+#define UART_STREAM_BATCH_MAX   512
+// longest tag of the stream
+#define UART_STREAM_TAG_MAX     32
+// longest read with the UART held, so cloud driver UART commands get a turn (ticks)
+#define UART_STREAM_READ_WAIT   5
+// stream thread stack (bytes) and priority, as the sensor thread
+#define UART_STREAM_STACK_SIZE  2048
+#define UART_STREAM_PRIORITY    10
+
+// uart_stream modes
+#define UART_STREAM_OFF         0
+#define UART_STREAM_DELIMITED   1
+#define UART_STREAM_FIXED       2
+
+void uart_stream_init(void);
+int uart_stream_register(const char * p_message);
+void uart_stream_hold(void);
+void uart_stream_release(void);
+
+#endif /* UART_STREAM_H_ */
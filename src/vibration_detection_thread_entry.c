@@ -29,18 +29,71 @@
 
 #include <app.h>
 #include "vibration_detection_thread.h"
-#include <m1_agent.h>
+#include "event_batch.h"
+#include "bus_schedule.h"
+#include "json_writer.h"
+#include "deadband.h"
+#include "boot_timeline.h"
+#include "accel_calibration.h"
+#include "temp_compensation.h"
 
-#include <stdio.h>
+#include <math.h>
 
 float mag_calc(float x, float y, float z);
 float q_sqrt(float x);
+float energy_calc(float tot, float sq_tot, uint16_t cnt);
+bool energy_changed(float energy, float ref_energy);
 void vibration_detection_thread_entry(void);
 
-#define USE_SHARED_BUS
 #define SLEEP_STEP 1
+// the temperature register is appended to the burst read every N samples
+#define TEMP_READ_DIVIDER 100
+
+// absolute energy change (g^2) always treated as noise by the adaptive window
+#define WINDOW_ENERGY_FLOOR 0.0001f
+
+#if defined(BMC150) && defined(BMC150_MAG) && !defined(I2C_VIBRATION)
+// BMM150 magnetometer half of the BMC150, on its own chip select
+#define MAG_SENSOR
+#endif
+// the magnetometer runs at 10 Hz, so it is read every N samples
+#define MAG_READ_DIVIDER 10
+// motor detection looks at the field range over blocks of N magnetometer samples
+#define MAG_MOTOR_BLOCK 10
+// uT per LSB of the uncompensated BMM150 data registers
+#define MAG_XY_SCALE 0.3f
+#define MAG_Z_SCALE 0.15f
+
+// window fields run through the deadband filter
+enum
+{
+    WINDOW_FIELD_X_MAX, WINDOW_FIELD_X_MIN, WINDOW_FIELD_X_AVG,
+    WINDOW_FIELD_Y_MAX, WINDOW_FIELD_Y_MIN, WINDOW_FIELD_Y_AVG,
+    WINDOW_FIELD_Z_MAX, WINDOW_FIELD_Z_MIN, WINDOW_FIELD_Z_AVG,
+    WINDOW_FIELD_ENERGY, WINDOW_FIELD_TEMP,
+    WINDOW_FIELD_MAG_MAX, WINDOW_FIELD_MAG_MIN, WINDOW_FIELD_MAG_AVG, WINDOW_FIELD_MAG_HEADING,
+    WINDOW_FIELD_COUNT
+};
+// changes below these are always suppressed by the deadband filter
+#define DEADBAND_ACCEL      0.002f
+#define DEADBAND_TEMP       0.5f
+#define DEADBAND_MAG        0.5f
+#define DEADBAND_HEADING    2.0f
 
 int sample_period = 6000;
+int window_adaptive = 0;
+int window_max_period = 60000;
+int window_tolerance = 25;
+int impact_threshold = 500;
+int impact_severe = 3000;
+int impact_refractory = 20;
+volatile int calibration_request = CALIBRATION_REQUEST_NONE;
+volatile int temp_comp_request = 1;
+int mag_gate = 0;
+int window_cbor = 0;
+int mag_motor_threshold = 2;
+int window_deadband = 0;
+int window_snapshot = 10;
 
 /******************************************************************************
 * Function Name: q_sqrt
@@ -71,6 +124,44 @@ float mag_calc(float x, float y, float z) {
     return q_sqrt(x * x + y * y + z * z);
 }
 
+/******************************************************************************
+* Function Name: energy_calc
+* Description  : Calculates the signal energy (variance of the acceleration
+*                magnitude) from running sums.
+* Arguments    : tot –
+*                    sum of the magnitudes.
+* Arguments    : sq_tot –
+*                    sum of the squared magnitudes.
+* Arguments    : cnt –
+*                    number of samples in the sums.
+* Return Value : The variance, or -1 if there are no samples.
+******************************************************************************/
+float energy_calc(float tot, float sq_tot, uint16_t cnt) {
+    if (cnt == 0)
+        return -1;
+    float avg = tot / cnt;
+    float energy = sq_tot / cnt - avg * avg;
+    return (energy < 0) ? 0 : energy;
+}
+
+/******************************************************************************
+* Function Name: energy_changed
+* Description  : Decides whether the signal energy moved outside the band of
+*                window_tolerance percent (plus WINDOW_ENERGY_FLOOR) around
+*                the reference energy.
+* Arguments    : energy –
+*                    energy of the most recent chunk.
+* Arguments    : ref_energy –
+*                    energy of the previous chunk, negative if unknown.
+* Return Value : true if the energy changed.
+******************************************************************************/
+bool energy_changed(float energy, float ref_energy) {
+    if (energy < 0 || ref_energy < 0)
+        return true;
+    float delta = (energy > ref_energy) ? energy - ref_energy : ref_energy - energy;
+    return delta > ref_energy * (float)window_tolerance / 100 + WINDOW_ENERGY_FLOOR;
+}
+
 volatile bool send_connect_event = true;
 
 /******************************************************************************
@@ -90,19 +181,67 @@ volatile bool send_connect_event = true;
 *                Aggregates are sent to the cloud every sample_period. Also
 *                calculates min, max, and average acceleration magnitude, but
 *                does not send to the cloud.
+*                If window_adaptive is set (vibration_window_adaptive, off
+*                by default), the signal energy is compared
+*                every sample_period. While it stays within window_tolerance
+*                the window is doubled each time it closes, up to
+*                window_max_period. On an energy change the window closes
+*                at once and falls back to sample_period.
+*                Every sample is also run through an impact detector: a
+*                jump in magnitude above impact_threshold (mg) between two
+*                samples counts as an impact, after which further impacts
+*                are ignored for impact_refractory ticks. The window event
+*                reports the impact count and the peak and time of the
+*                largest impact. Impacts reaching impact_severe (mg) are
+*                published at once in their own event.
+*                Raw readings are converted to g by the calibration
+*                transform loaded from data-flash. calibration_request
+*                drives the static calibration procedure: an orientation
+*                number averages CALIBRATION_SAMPLES raw readings for that
+*                orientation, CALIBRATION_REQUEST_SOLVE computes and stores
+*                the transform, CALIBRATION_REQUEST_RESET erases it.
+*                Every TEMP_READ_DIVIDER samples the burst read is extended
+*                by the temperature register. Windows taken at rest train
+*                the temperature compensation table, and the offset for
+*                the current temperature is folded into the transform.
+*                temp_comp_request: 1 enables, 0 disables and -1 clears the
+*                compensation.
+*                With the SPI BMC150 and BMC150_MAG, the magnetometer
+*                (g_sf_spi_device1) is
+*                read every MAG_READ_DIVIDER samples, in the same tick as an
+*                accelerometer read so the accelerometer cadence is kept.
+*                The window event adds field strength min, max and average
+*                (uT) and the heading of the average field. The motor is
+*                taken as running while the field range over a block of
+*                MAG_MOTOR_BLOCK readings exceeds mag_motor_threshold (uT).
+*                If mag_gate is set and the motor is off, the accelerometer
+*                is only sampled with the magnetometer.
+*                With window_cbor set, the window event is sent CBOR
+*                encoded (see json_writer).
+*                With window_deadband (%) set, the min, max, average,
+*                energy, temperature and field values are only sent when
+*                they moved by more than that since they were last sent,
+*                or by more than the DEADBAND_ limits for values near
+*                zero. Every window_snapshot windows all of them are sent,
+*                marked "snapshot":true.
 ******************************************************************************/
 void vibration_detection_thread_entry(void)
 {
     char buf[20];
-    char eventbuf[500] = {0};
+    char eventbuf[600] = {0};
+    char notifybuf[80];
+    json_writer_t writer;
     int sleep_count = 0;
+    int chunk_count = 0;
+    int window_period = sample_period;
     ssp_err_t err;
 
     uint8_t first_flag = 0;
+    bool window_close = false;
     uint16_t sample_cnt = 0;
-    uint8_t x_zero_cross = 0;
-    uint8_t y_zero_cross = 0;
-    uint8_t z_zero_cross = 0;
+    uint16_t x_zero_cross = 0;
+    uint16_t y_zero_cross = 0;
+    uint16_t z_zero_cross = 0;
     float x_prev_avg = 0;
     float y_prev_avg = 0;
     float z_prev_avg = 0;
@@ -112,6 +251,27 @@ void vibration_detection_thread_entry(void)
     float mag_max = -1000000;
     float mag_min = 1000000;
     float mag_tot = 0;
+    float mag_sq_tot = 0;
+    float chunk_mag_tot = 0;
+    float chunk_mag_sq_tot = 0;
+    uint16_t chunk_sample_cnt = 0;
+    float ref_energy = -1;
+    float mag_last = -1;
+    int impact_hold = 0;
+    uint16_t impact_cnt = 0;
+    float impact_peak = 0;
+    int impact_peak_ms = 0;
+    accel_transform_t transform;
+    accel_transform_t applied;
+    int temp_divider = TEMP_READ_DIVIDER;
+    bool temp_read;
+    bool temp_comp_enabled = true;
+    float temp_c = 23;
+    int calibration_orientation = -1;
+    int calibration_cnt = 0;
+    float x_cal_tot = 0;
+    float y_cal_tot = 0;
+    float z_cal_tot = 0;
     float x_max = -1000000;
     float x_min = 1000000;
     float x_tot = 0;
@@ -121,6 +281,40 @@ void vibration_detection_thread_entry(void)
     float z_max = -1000000;
     float z_min = 1000000;
     float z_tot = 0;
+    deadband_t window_filter;
+    deadband_field_t window_fields[WINDOW_FIELD_COUNT] =
+    {
+        [WINDOW_FIELD_X_MAX] = { .absolute = DEADBAND_ACCEL },
+        [WINDOW_FIELD_X_MIN] = { .absolute = DEADBAND_ACCEL },
+        [WINDOW_FIELD_X_AVG] = { .absolute = DEADBAND_ACCEL },
+        [WINDOW_FIELD_Y_MAX] = { .absolute = DEADBAND_ACCEL },
+        [WINDOW_FIELD_Y_MIN] = { .absolute = DEADBAND_ACCEL },
+        [WINDOW_FIELD_Y_AVG] = { .absolute = DEADBAND_ACCEL },
+        [WINDOW_FIELD_Z_MAX] = { .absolute = DEADBAND_ACCEL },
+        [WINDOW_FIELD_Z_MIN] = { .absolute = DEADBAND_ACCEL },
+        [WINDOW_FIELD_Z_AVG] = { .absolute = DEADBAND_ACCEL },
+        [WINDOW_FIELD_ENERGY] = { .absolute = WINDOW_ENERGY_FLOOR },
+        [WINDOW_FIELD_TEMP] = { .absolute = DEADBAND_TEMP },
+        [WINDOW_FIELD_MAG_MAX] = { .absolute = DEADBAND_MAG },
+        [WINDOW_FIELD_MAG_MIN] = { .absolute = DEADBAND_MAG },
+        [WINDOW_FIELD_MAG_AVG] = { .absolute = DEADBAND_MAG },
+        [WINDOW_FIELD_MAG_HEADING] = { .absolute = DEADBAND_HEADING },
+    };
+#ifdef MAG_SENSOR
+    char magbuf[16];
+    int mag_divider = MAG_READ_DIVIDER;
+    bool mag_read = false;
+    bool motor_on = true;
+    uint16_t mag_cnt = 0;
+    float mag_field_max = -1000000;
+    float mag_field_min = 1000000;
+    float mag_field_tot = 0;
+    float mag_x_tot = 0;
+    float mag_y_tot = 0;
+    int mag_block_cnt = 0;
+    float mag_block_max = -1000000;
+    float mag_block_min = 1000000;
+#endif
 
 
 #ifdef BMC150
@@ -140,6 +334,18 @@ void vibration_detection_thread_entry(void)
     //read acceleration
     err = g_sf_spi_device0.p_api->open(g_sf_spi_device0.p_ctrl, g_sf_spi_device0.p_cfg);
     APP_ERR_TRAP(err);
+#ifdef MAG_SENSOR
+    // magnetometer: power on to sleep mode, then normal mode at 10 Hz
+    err = g_sf_spi_device1.p_api->open(g_sf_spi_device1.p_ctrl, g_sf_spi_device1.p_cfg);
+    APP_ERR_TRAP(err);
+    magbuf[0] = 0x4B;
+    magbuf[1] = 0x01;
+    g_sf_spi_device1.p_api->write(g_sf_spi_device1.p_ctrl, magbuf, 2, SPI_BIT_WIDTH_8_BITS, TX_WAIT_FOREVER);
+    tx_thread_sleep(1);
+    magbuf[0] = 0x4C;
+    magbuf[1] = 0x00;
+    g_sf_spi_device1.p_api->write(g_sf_spi_device1.p_ctrl, magbuf, 2, SPI_BIT_WIDTH_8_BITS, TX_WAIT_FOREVER);
+#endif
 #endif
 #else
     // init pmodacl2
@@ -159,66 +365,206 @@ void vibration_detection_thread_entry(void)
     err = g_sf_spi_device0.p_api->close(g_sf_spi_device0.p_ctrl);
 #endif
 
+    deadband_init(&window_filter, window_fields, WINDOW_FIELD_COUNT);
+    accel_calibration_load(&transform);
+    temp_comp_apply(&transform, temp_c, false, &applied);
+
     while (1) {
-        if (sleep_count > sample_period) {
-            sleep_count = 0;
+        if (calibration_request != CALIBRATION_REQUEST_NONE) {
+            int request = calibration_request;
+            calibration_request = CALIBRATION_REQUEST_NONE;
+            if (request == CALIBRATION_REQUEST_RESET || request == CALIBRATION_REQUEST_SOLVE) {
+                if (request == CALIBRATION_REQUEST_RESET) {
+                    accel_calibration_erase();
+                    accel_calibration_default(&transform);
+                    event_batch_publish("{\"calibrated\":false}", EVENT_PRIORITY_REPLY);
+                } else if (accel_calibration_solve(&transform) && accel_calibration_save(&transform)) {
+                    event_batch_publish("{\"calibrated\":true}", EVENT_PRIORITY_REPLY);
+                } else {
+                    event_batch_publish("{\"calibrated\":false}", EVENT_PRIORITY_REPLY);
+                }
+                // a new calibration invalidates what was learned on the old one
+                temp_comp_reset();
+                deadband_reset(&window_filter);
+                temp_comp_apply(&transform, temp_c, temp_comp_enabled, &applied);
+            } else if (request >= 0 && request < CALIBRATION_ORIENTATIONS) {
+                calibration_orientation = request;
+                calibration_cnt = 0;
+                x_cal_tot = 0;
+                y_cal_tot = 0;
+                z_cal_tot = 0;
+            }
+        }
+        if (temp_comp_request != (int)temp_comp_enabled) {
+            if (temp_comp_request < 0) {
+                temp_comp_reset();
+                temp_comp_request = temp_comp_enabled;
+            } else {
+                temp_comp_enabled = temp_comp_request != 0;
+            }
+            temp_comp_apply(&transform, temp_c, temp_comp_enabled, &applied);
+        }
+        if (chunk_count > sample_period) {
+            chunk_count = 0;
             if (first_flag) {
-                x_prev_avg = x_tot / sample_cnt;
-                y_prev_avg = y_tot / sample_cnt;
-                z_prev_avg = z_tot / sample_cnt;
-                sprintf(eventbuf, "{"
-                        "\"x_max\":%f,"
-                        "\"x_min\":%f,"
-                        "\"x_avg\":%f,"
-                        "\"y_max\":%f,"
-                        "\"y_min\":%f,"
-                        "\"y_avg\":%f,"
-                        "\"z_max\":%f,"
-                        "\"z_min\":%f,"
-                        "\"z_avg\":%f,"
-                        "\"sample_cnt\":%u,"
-                        "\"x_zero_cross\":%u,"
-                        "\"y_zero_cross\":%u,"
-                        "\"z_zero_cross\":%u,"
-                        "}"
-                        ,
-                        x_max,
-                        x_min,
-                        x_tot / sample_cnt,
-                        y_max,
-                        y_min,
-                        y_tot / sample_cnt,
-                        z_max,
-                        z_min,
-                        z_tot / sample_cnt,
-                        sample_cnt,
-                        x_zero_cross,
-                        y_zero_cross,
-                        z_zero_cross
-                        );
-                m1_publish_event(eventbuf, NULL);
-                sample_cnt = 0;
-                x_zero_cross = 0;
-                y_zero_cross = 0;
-                z_zero_cross = 0;
-                mag_max = 0;
-                mag_min = 1000000;
-                mag_tot = 0;
-                x_max = -1000000;
-                x_min = 1000000;
-                x_tot = 0;
-                y_max = -1000000;
-                y_min = 1000000;
-                y_tot = 0;
-                z_max = -1000000;
-                z_min = 1000000;
-                z_tot = 0;
-                first_flag = 0;
+                float chunk_energy = energy_calc(mag_tot - chunk_mag_tot,
+                                                 mag_sq_tot - chunk_mag_sq_tot,
+                                                 (uint16_t)(sample_cnt - chunk_sample_cnt));
+                bool changed = energy_changed(chunk_energy, ref_energy);
+                ref_energy = chunk_energy;
+                chunk_mag_tot = mag_tot;
+                chunk_mag_sq_tot = mag_sq_tot;
+                chunk_sample_cnt = sample_cnt;
+                if (!window_adaptive || changed || window_period < sample_period)
+                    window_period = sample_period;
+                if (changed || sleep_count > window_period) {
+                    window_close = true;
+                    if (window_adaptive && !changed) {
+                        window_period *= 2;
+                        if (window_period > window_max_period)
+                            window_period = (window_max_period > sample_period) ? window_max_period : sample_period;
+                    }
+                }
+            }
+        }
+        if (window_close) {
+            window_close = false;
+            x_prev_avg = x_tot / sample_cnt;
+            y_prev_avg = y_tot / sample_cnt;
+            z_prev_avg = z_tot / sample_cnt;
+            float window_energy = energy_calc(mag_tot, mag_sq_tot, sample_cnt);
+            if (temp_comp_enabled && calibration_orientation < 0 && window_energy < TEMP_COMP_LEARN_ENERGY)
+                temp_comp_learn(temp_c, x_prev_avg, y_prev_avg, z_prev_avg);
+            if (window_cbor)
+                json_begin_cbor(&writer, eventbuf, sizeof(eventbuf));
+            else
+                json_begin(&writer, eventbuf, sizeof(eventbuf));
+            if (deadband_begin(&window_filter, window_deadband, window_snapshot) && window_deadband > 0)
+                json_key_bool(&writer, "snapshot", true);
+            deadband_key_float(&writer, &window_filter, WINDOW_FIELD_X_MAX, "x_max", x_max, 4);
+            deadband_key_float(&writer, &window_filter, WINDOW_FIELD_X_MIN, "x_min", x_min, 4);
+            deadband_key_float(&writer, &window_filter, WINDOW_FIELD_X_AVG, "x_avg", x_tot / sample_cnt, 4);
+            deadband_key_float(&writer, &window_filter, WINDOW_FIELD_Y_MAX, "y_max", y_max, 4);
+            deadband_key_float(&writer, &window_filter, WINDOW_FIELD_Y_MIN, "y_min", y_min, 4);
+            deadband_key_float(&writer, &window_filter, WINDOW_FIELD_Y_AVG, "y_avg", y_tot / sample_cnt, 4);
+            deadband_key_float(&writer, &window_filter, WINDOW_FIELD_Z_MAX, "z_max", z_max, 4);
+            deadband_key_float(&writer, &window_filter, WINDOW_FIELD_Z_MIN, "z_min", z_min, 4);
+            deadband_key_float(&writer, &window_filter, WINDOW_FIELD_Z_AVG, "z_avg", z_tot / sample_cnt, 4);
+            json_key_uint(&writer, "sample_cnt", sample_cnt);
+            json_key_int(&writer, "window_ms", sleep_count * 10);
+            deadband_key_float(&writer, &window_filter, WINDOW_FIELD_ENERGY, "energy", window_energy, 6);
+            json_key_uint(&writer, "impact_cnt", impact_cnt);
+            json_key_float(&writer, "impact_peak_g", impact_peak, 4);
+            json_key_int(&writer, "impact_peak_ms", impact_peak_ms);
+            deadband_key_float(&writer, &window_filter, WINDOW_FIELD_TEMP, "temp_c", temp_c, 1);
+            json_key_uint(&writer, "x_zero_cross", x_zero_cross);
+            json_key_uint(&writer, "y_zero_cross", y_zero_cross);
+            json_key_uint(&writer, "z_zero_cross", z_zero_cross);
+#ifdef MAG_SENSOR
+            if (mag_cnt) {
+                float mag_heading = atan2f(mag_y_tot, mag_x_tot) * 57.29578f;
+                if (mag_heading < 0)
+                    mag_heading += 360;
+                json_key_uint(&writer, "mag_cnt", mag_cnt);
+                deadband_key_float(&writer, &window_filter, WINDOW_FIELD_MAG_MAX, "mag_field_max", mag_field_max, 2);
+                deadband_key_float(&writer, &window_filter, WINDOW_FIELD_MAG_MIN, "mag_field_min", mag_field_min, 2);
+                deadband_key_float(&writer, &window_filter, WINDOW_FIELD_MAG_AVG, "mag_field_avg", mag_field_tot / mag_cnt, 2);
+                deadband_key_float(&writer, &window_filter, WINDOW_FIELD_MAG_HEADING, "mag_heading", mag_heading, 1);
+                json_key_bool(&writer, "motor_on", motor_on);
+            }
+            mag_cnt = 0;
+            mag_field_max = -1000000;
+            mag_field_min = 1000000;
+            mag_field_tot = 0;
+            mag_x_tot = 0;
+            mag_y_tot = 0;
+#endif
+            if (json_end(&writer) > 0 && event_batch_publish(eventbuf, EVENT_PRIORITY_BULK) == 0)
+                boot_mark(BOOT_FIRST_TELEMETRY);
+            sample_cnt = 0;
+            x_zero_cross = 0;
+            y_zero_cross = 0;
+            z_zero_cross = 0;
+            mag_max = 0;
+            mag_min = 1000000;
+            mag_tot = 0;
+            mag_sq_tot = 0;
+            chunk_mag_tot = 0;
+            chunk_mag_sq_tot = 0;
+            chunk_sample_cnt = 0;
+            impact_cnt = 0;
+            impact_peak = 0;
+            impact_peak_ms = 0;
+            x_max = -1000000;
+            x_min = 1000000;
+            x_tot = 0;
+            y_max = -1000000;
+            y_min = 1000000;
+            y_tot = 0;
+            z_max = -1000000;
+            z_min = 1000000;
+            z_tot = 0;
+            first_flag = 0;
+            sleep_count = 0;
+        }
+#ifdef MAG_SENSOR
+        mag_read = (mag_divider >= MAG_READ_DIVIDER);
+        if (mag_read) {
+            mag_divider = 0;
+            magbuf[0] = (char)(0x80 | 0x42);
+            err = g_sf_spi_device1.p_api->writeRead(g_sf_spi_device1.p_ctrl, magbuf, &magbuf[8], 7, SPI_BIT_WIDTH_8_BITS, TX_WAIT_FOREVER);
+            if (err == SSP_SUCCESS) {
+                // X and Y are 13 bit, Z is 15 bit, all left-aligned in their register pairs
+                int16_t xmag = (int16_t)(((int8_t)magbuf[10] * 32) | ((uint8_t)magbuf[9] >> 3));
+                int16_t ymag = (int16_t)(((int8_t)magbuf[12] * 32) | ((uint8_t)magbuf[11] >> 3));
+                int16_t zmag = (int16_t)(((int8_t)magbuf[14] * 128) | ((uint8_t)magbuf[13] >> 1));
+                // -4096 and -16384 flag an overflowed axis
+                if (xmag != -4096 && ymag != -4096 && zmag != -16384) {
+                    float fXMag = xmag * MAG_XY_SCALE;
+                    float fYMag = ymag * MAG_XY_SCALE;
+                    float field = mag_calc(fXMag, fYMag, zmag * MAG_Z_SCALE);
+                    if (field > mag_field_max)
+                        mag_field_max = field;
+                    if (field < mag_field_min)
+                        mag_field_min = field;
+                    mag_field_tot += field;
+                    mag_x_tot += fXMag;
+                    mag_y_tot += fYMag;
+                    mag_cnt++;
+                    if (field > mag_block_max)
+                        mag_block_max = field;
+                    if (field < mag_block_min)
+                        mag_block_min = field;
+                    if (++mag_block_cnt == MAG_MOTOR_BLOCK) {
+                        bool running = (mag_block_max - mag_block_min) > (float)mag_motor_threshold;
+                        if (running != motor_on) {
+                            motor_on = running;
+                            json_begin(&writer, notifybuf, sizeof(notifybuf));
+                            json_key_bool(&writer, "motor_on", motor_on);
+                            if (json_end(&writer) > 0)
+                                event_batch_publish(notifybuf, EVENT_PRIORITY_INTERACTIVE);
+                        }
+                        mag_block_cnt = 0;
+                        mag_block_max = -1000000;
+                        mag_block_min = 1000000;
+                    }
+                }
             }
         }
+        mag_divider++;
+        if (mag_gate && !motor_on && !mag_read && calibration_orientation < 0) {
+            // motor off: skip the vibration analysis between magnetometer reads
+            tx_thread_sleep(SLEEP_STEP);
+            sleep_count += SLEEP_STEP;
+            chunk_count += SLEEP_STEP;
+            continue;
+        }
+#endif
+        temp_read = (temp_divider >= TEMP_READ_DIVIDER);
 #ifdef BMC150
 #ifdef I2C_VIBRATION
         buf[0] = 0x02;
+        bus_schedule_sample_begin();
 #ifdef USE_SHARED_BUS
         err = g_sf_i2c_device4.p_api->write(g_sf_i2c_device4.p_ctrl, buf, 1, true, 100);
 #else
@@ -232,40 +578,86 @@ void vibration_detection_thread_entry(void)
 #endif
         }
 #ifdef USE_SHARED_BUS
-        err = g_sf_i2c_device4.p_api->read(g_sf_i2c_device4.p_ctrl, &buf[8], 6, false, 10);
+        err = g_sf_i2c_device4.p_api->read(g_sf_i2c_device4.p_ctrl, &buf[8], temp_read ? 7 : 6, false, 10);
 #else
-        err = g_i2c1.p_api->read(g_i2c1.p_ctrl, &buf[8], 6, false);
+        err = g_i2c1.p_api->read(g_i2c1.p_ctrl, &buf[8], temp_read ? 7 : 6, false);
 #endif
+        bus_schedule_sample_end();
 #else
         buf[0] = (char)(0x80 | 0x02);
-        err = g_sf_spi_device0.p_api->writeRead(g_sf_spi_device0.p_ctrl, buf, &buf[7], 7, SPI_BIT_WIDTH_8_BITS, TX_WAIT_FOREVER);
+        err = g_sf_spi_device0.p_api->writeRead(g_sf_spi_device0.p_ctrl, buf, &buf[7], temp_read ? 8 : 7, SPI_BIT_WIDTH_8_BITS, TX_WAIT_FOREVER);
 #endif
 #else
         buf[0] = 0x0B;
         buf[1] = 0x0e;
-        err = g_sf_spi_device0.p_api->writeRead(g_sf_spi_device0.p_ctrl, buf, &buf[8], 8, SPI_BIT_WIDTH_8_BITS, TX_WAIT_FOREVER);
+        err = g_sf_spi_device0.p_api->writeRead(g_sf_spi_device0.p_ctrl, buf, &buf[8], temp_read ? 10 : 8, SPI_BIT_WIDTH_8_BITS, TX_WAIT_FOREVER);
 #endif
+        temp_divider++;
         if (err == SSP_SUCCESS) {
+            if (temp_read) {
+#ifdef BMC150
+                // ACCD_TEMP follows the acceleration registers: 0.5 K/LSB, 0 at 23 C
+                temp_c = 23 + (int8_t)buf[14] * 0.5f;
+#else
+                // TEMP_L/TEMP_H follow the acceleration registers: 0.065 C/LSB, 350 at 25 C
+                temp_c = 25 + ((int16_t)((uint8_t)buf[16] | (buf[17] << 8)) - 350) * 0.065f;
+#endif
+                temp_comp_apply(&transform, temp_c, temp_comp_enabled, &applied);
+                temp_divider = 0;
+            }
 #ifdef BMC150
             int16_t xaccel = (int16_t)(((buf[8] >> 4) & 0x0f) | (((int16_t)buf[9]) << 4));
             int16_t yaccel = (int16_t)(((buf[10] >> 4) & 0x0f) | (((int16_t)buf[11]) << 4));
             int16_t zaccel = (int16_t)(((buf[12] >> 4) & 0x0f) | (((int16_t)buf[13]) << 4));
-
-            float fXAccel = xaccel * 0.00098f;
-            float fYAccel = yaccel * 0.00098f;
-            float fZAccel = zaccel * 0.00098f;
 #else
-            int16_t xAccel = buf[10] | (buf[11] << 8);
-            int16_t yAccel = buf[12] | (buf[13] << 8);
-            int16_t zAccel = buf[14] | (buf[15] << 8);
-
-            float dScale = 0.004;
-
-            float fXAccel = xAccel * dScale;
-            float fYAccel = yAccel * dScale;
-            float fZAccel = zAccel * dScale;
+            int16_t xaccel = buf[10] | (buf[11] << 8);
+            int16_t yaccel = buf[12] | (buf[13] << 8);
+            int16_t zaccel = buf[14] | (buf[15] << 8);
 #endif
+            // raw-to-g scale, calibration and temperature offset in one affine transform
+            float fXAccel = applied.gain[0] * xaccel + applied.gain[1] * yaccel + applied.gain[2] * zaccel + applied.offset[0];
+            float fYAccel = applied.gain[3] * xaccel + applied.gain[4] * yaccel + applied.gain[5] * zaccel + applied.offset[1];
+            float fZAccel = applied.gain[6] * xaccel + applied.gain[7] * yaccel + applied.gain[8] * zaccel + applied.offset[2];
+
+            if (calibration_orientation >= 0) {
+                x_cal_tot += xaccel;
+                y_cal_tot += yaccel;
+                z_cal_tot += zaccel;
+                if (++calibration_cnt == CALIBRATION_SAMPLES) {
+                    accel_calibration_capture(calibration_orientation,
+                                              x_cal_tot / CALIBRATION_SAMPLES,
+                                              y_cal_tot / CALIBRATION_SAMPLES,
+                                              z_cal_tot / CALIBRATION_SAMPLES);
+                    json_begin(&writer, notifybuf, sizeof(notifybuf));
+                    json_key_int(&writer, "calibration_step", calibration_orientation);
+                    if (json_end(&writer) > 0)
+                        event_batch_publish(notifybuf, EVENT_PRIORITY_REPLY);
+                    calibration_orientation = -1;
+                }
+            }
             float mag_accel = mag_calc(fXAccel, fYAccel, fZAccel);
+            if (impact_hold > 0) {
+                impact_hold -= SLEEP_STEP;
+            } else if (mag_last >= 0) {
+                float jerk = (mag_accel > mag_last) ? mag_accel - mag_last : mag_last - mag_accel;
+                if (jerk * 1000 > (float)impact_threshold) {
+                    impact_hold = impact_refractory;
+                    impact_cnt++;
+                    if (mag_accel > impact_peak) {
+                        impact_peak = mag_accel;
+                        impact_peak_ms = sleep_count * 10;
+                    }
+                    if (mag_accel * 1000 >= (float)impact_severe) {
+                        json_begin(&writer, notifybuf, sizeof(notifybuf));
+                        json_key_bool(&writer, "impact", true);
+                        json_key_float(&writer, "impact_g", mag_accel, 4);
+                        json_key_float(&writer, "impact_jerk", jerk, 4);
+                        if (json_end(&writer) > 0)
+                            event_batch_publish(notifybuf, EVENT_PRIORITY_INTERACTIVE);
+                    }
+                }
+            }
+            mag_last = mag_accel;
             if (mag_accel > mag_max) {
                 mag_max = mag_accel;
             }
@@ -303,6 +695,7 @@ void vibration_detection_thread_entry(void)
                 z_zero_cross++;
             }
             mag_tot += mag_accel;
+            mag_sq_tot += mag_accel * mag_accel;
             sample_cnt++;
             first_flag = 1;
             x_last = fXAccel;
@@ -311,5 +704,6 @@ void vibration_detection_thread_entry(void)
         }
         tx_thread_sleep(SLEEP_STEP);
         sleep_count += SLEEP_STEP;
+        chunk_count += SLEEP_STEP;
     }
 }
@@ -0,0 +1,434 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : bus_schedule_test.c
+ * Version      : 1.0
+ * Device(s)    : Linux host
+ * Tool-Chain   : GNU GCC
+ * OS           : none
+ * H/W Platform : host
+ * Description  : Host test of src/bus_schedule.c, built with BUS_SCHEDULE,
+ *                on a simulated shared I2C bus. A simulated vibration
+ *                thread wakes on every tick with some latency, marks the
+ *                sample and holds the bus for one accelerometer read; a
+ *                cloud driver command waits for the bus like the I2C
+ *                framework and then holds it for its transfer. Waiting
+ *                on the scheduler's event flags moves the simulated time
+ *                from one sample event to the next, and timestamp_us
+ *                reads it, starting just before the time stamp wraps.
+ *                Runs a random mix of commands, short and too long for a
+ *                gap, through bus_schedule_command and checks that:
+ *                    a sample is only delayed by a command counted as an
+ *                    overrun, or on resuming after a pause, and a command
+ *                    that fits a gap never overruns;
+ *                    no command is starved while sampling goes on;
+ *                    deferred and wait_max_us match the simulated waits;
+ *                    samples and jitter_max_us match the simulated wakes.
+ *                Then runs the same commands straight on the bus, and
+ *                prints how many samples each way delayed.
+ *                Build and run (or use tools/host_tests.sh):
+ *                    cc -std=gnu99 -O2 -DI2C_VIBRATION -DUSE_SHARED_BUS
+ *                       -Itools/threadx_host -Isrc -Im1
+ *                       src/bus_schedule.c src/json_writer.c
+ *                       tools/bus_schedule_test.c -o bus_schedule_test
+ *                    ./bus_schedule_test [commands]
+ ******************************************************************************/
+
+#include "tx_api.h"
+#include "bus_schedule.h"
+#include "read_cache.h"
+#include "timestamp.h"
+#include "uart_stream.h"
+#include <m1_cloud_driver.h>
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef BUS_SCHEDULE
+#error build with I2C_VIBRATION and USE_SHARED_BUS
+#endif
+
+#define TEST_COMMANDS       100000L
+// ThreadX tick (us)
+#define TEST_TICK_US        10000
+// bus time of one accelerometer read: register write, restart, 7 bytes
+#define TEST_SAMPLE_BUS_US  1000
+// latest wake of the vibration thread after its tick
+#define TEST_LATENCY_US     200
+// start, address and stop of a cloud transfer, within BUS_SCHEDULE_GUARD_US
+#define TEST_OVERHEAD_US    200
+// a command which has waited this long is starved
+#define TEST_STARVED_US     1000000
+// the time stamp wraps 3 s into the run
+#define TEST_START_US       (0x100000000ULL - 3000000)
+
+static uint32_t random_state = 12345;
+static int checks = 0;
+static int failures = 0;
+
+// simulated time (us), and the vibration thread
+static uint64_t now = TEST_START_US;
+static uint64_t wake_at;            ///< next wake of the vibration thread.
+static uint64_t sample_end_at;      ///< end of the read of the current sample.
+static bool in_sample = false;
+static uint64_t last_begin = 0;
+static uint32_t sim_samples = 0;    ///< intervals of up to two periods.
+static uint32_t sim_jitter_max = 0;
+static uint32_t delayed = 0;        ///< samples which found the bus held by a command.
+static uint32_t resumed = 0;        ///< of them, the first samples after a pause.
+
+// the command on the bus
+static uint64_t bus_free_at = 0;
+static uint64_t called_at;          ///< when m1_handle_message was called.
+static uint64_t starved_at;
+
+static TX_EVENT_FLAGS_GROUP * p_flags = NULL;
+
+/******************************************************************************
+* Function Name: test_check
+* Description  : Counts a check and reports it if it failed.
+* Arguments    : ok –
+*                    result of the check.
+*                what -
+*                    description printed on failure.
+******************************************************************************/
+static void test_check(bool ok, const char * what) {
+    checks++;
+    if (!ok) {
+        failures++;
+        fprintf(stderr, "FAIL %s\n", what);
+    }
+}
+
+/******************************************************************************
+* Function Name: test_random
+* Description  : xorshift32 pseudo-random numbers, the same on every run.
+* Return Value : next number.
+******************************************************************************/
+static uint32_t test_random(void) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+/******************************************************************************
+* Function Name: test_next_wake
+* Description  : Schedules the wake after a sample: the next tick after its
+*                end, as tx_thread_sleep(1), or now and then a pause of the
+*                stream, plus the wake latency.
+* Arguments    : end –
+*                    end of the sample.
+******************************************************************************/
+static void test_next_wake(uint64_t end) {
+    if (test_random() % 500 == 0)
+        end += 30000 + test_random() % 70000;
+    wake_at = (end / TEST_TICK_US + 1) * TEST_TICK_US + test_random() % (TEST_LATENCY_US + 1);
+}
+
+/******************************************************************************
+* Function Name: test_run_until
+* Description  : Moves the simulated time, running the vibration thread's
+*                wakes and sample ends on the way.
+* Arguments    : until –
+*                    new simulated time.
+******************************************************************************/
+static void test_run_until(uint64_t until) {
+    while (1) {
+        uint64_t next = in_sample ? sample_end_at : wake_at;
+
+        if (next > until)
+            break;
+        now = next;
+        if (in_sample) {
+            in_sample = false;
+            bus_schedule_sample_end();
+            test_next_wake(now);
+            continue;
+        }
+        bus_schedule_sample_begin();
+        // the read waits for a command on the bus; after a pause of the
+        // stream the scheduler cannot know when it resumes
+        if (bus_free_at > now) {
+            delayed++;
+            if (now - last_begin > 2 * BUS_SCHEDULE_SAMPLE_US)
+                resumed++;
+        }
+        if (last_begin && now - last_begin <= 2 * BUS_SCHEDULE_SAMPLE_US) {
+            uint64_t interval = now - last_begin;
+            uint32_t jitter = (uint32_t)((interval > BUS_SCHEDULE_SAMPLE_US) ? interval - BUS_SCHEDULE_SAMPLE_US
+                                                                              : BUS_SCHEDULE_SAMPLE_US - interval);
+            sim_samples++;
+            if (jitter > sim_jitter_max)
+                sim_jitter_max = jitter;
+        }
+        last_begin = now;
+        sample_end_at = ((bus_free_at > now) ? bus_free_at : now) + TEST_SAMPLE_BUS_US;
+        in_sample = true;
+    }
+    now = until;
+}
+
+/******************************************************************************
+* Function Name: test_transfer
+* Description  : Runs a cloud driver command on the simulated bus: waits for
+*                the sample holding it, then holds it for the transfer.
+* Arguments    : p_command –
+*                    cloud driver command.
+* Return Value : M1_SUCCESS_DATA for a read, M1_SUCCESS_NO_DATA otherwise.
+******************************************************************************/
+static int test_transfer(const char * p_command) {
+    unsigned int read_length;
+    unsigned int write_length;
+
+    if (sscanf(p_command, "3;2;%u;%u;", &read_length, &write_length) != 2)
+        return M1_SUCCESS_NO_DATA;
+    if (in_sample)
+        test_run_until(sample_end_at);
+    bus_free_at = now + TEST_OVERHEAD_US + (read_length + write_length) * BUS_SCHEDULE_BYTE_US;
+    test_run_until(bus_free_at);
+    return read_length ? M1_SUCCESS_DATA : M1_SUCCESS_NO_DATA;
+}
+
+uint32_t timestamp_us(void) {
+    return (uint32_t)now;
+}
+
+int m1_handle_message(const char * cloud_driver_command, char * rxBuf) {
+    called_at = now;
+    strcpy(rxBuf, "{}");
+    return test_transfer(cloud_driver_command);
+}
+
+void read_cache_flush(char port) {
+    (void)port;
+}
+
+void uart_stream_hold(void) {
+}
+
+void uart_stream_release(void) {
+}
+
+UINT tx_mutex_create(TX_MUTEX * mutex_ptr, CHAR * name_ptr, UINT inherit) {
+    (void)name_ptr;
+    (void)inherit;
+    mutex_ptr->tx_mutex_ownership_count = 0;
+    return TX_SUCCESS;
+}
+
+UINT tx_mutex_get(TX_MUTEX * mutex_ptr, ULONG wait_option) {
+    (void)wait_option;
+    mutex_ptr->tx_mutex_ownership_count++;
+    return TX_SUCCESS;
+}
+
+UINT tx_mutex_put(TX_MUTEX * mutex_ptr) {
+    mutex_ptr->tx_mutex_ownership_count--;
+    return TX_SUCCESS;
+}
+
+UINT tx_event_flags_create(TX_EVENT_FLAGS_GROUP * group_ptr, CHAR * name_ptr) {
+    (void)name_ptr;
+    group_ptr->tx_event_flags_group_current = 0;
+    p_flags = group_ptr;
+    return TX_SUCCESS;
+}
+
+UINT tx_event_flags_set(TX_EVENT_FLAGS_GROUP * group_ptr, ULONG flags_to_set, UINT set_option) {
+    (void)set_option;
+    group_ptr->tx_event_flags_group_current |= flags_to_set;
+    return TX_SUCCESS;
+}
+
+/******************************************************************************
+* Function Name: tx_event_flags_get
+* Description  : Waits for the flags by running the simulated vibration
+*                thread, event by event, up to the timeout in ticks. Ends
+*                the test if the command waiting is starved.
+******************************************************************************/
+UINT tx_event_flags_get(TX_EVENT_FLAGS_GROUP * group_ptr, ULONG requested_flags, UINT get_option,
+                        ULONG * actual_flags_ptr, ULONG wait_option) {
+    uint64_t deadline = now + (uint64_t)wait_option * TEST_TICK_US;
+
+    while (!(group_ptr->tx_event_flags_group_current & requested_flags)) {
+        uint64_t next = in_sample ? sample_end_at : wake_at;
+
+        if (now > starved_at) {
+            fprintf(stderr, "FAIL command starved while sampling goes on\n");
+            exit(1);
+        }
+        if (wait_option == TX_NO_WAIT)
+            return TX_NO_EVENTS;
+        if (next > deadline) {
+            test_run_until(deadline);
+            return TX_NO_EVENTS;
+        }
+        test_run_until(next);
+    }
+    *actual_flags_ptr = group_ptr->tx_event_flags_group_current;
+    if (get_option == TX_OR_CLEAR)
+        group_ptr->tx_event_flags_group_current &= ~requested_flags;
+    return TX_SUCCESS;
+}
+
+/******************************************************************************
+* Function Name: test_command
+* Description  : Draws a cloud driver command: mostly short reads, some
+*                writes and longer reads, and now and then a read too long
+*                for any gap or a command off the I2C bus.
+* Arguments    : p_buf –
+*                    receives the command.
+*                size -
+*                    size of p_buf.
+* Return Value : estimated transfer time (us), 0 off the I2C bus.
+******************************************************************************/
+static uint32_t test_command(char * p_buf, size_t size) {
+    uint32_t r = test_random() % 100;
+    uint32_t read_length;
+    uint32_t write_length = 1 + test_random() % 4;
+
+    if (r < 3) {
+        snprintf(p_buf, size, "0;4;4;gpio;");
+        return 0;
+    }
+    if (r < 70)
+        read_length = 1 + test_random() % 16;
+    else if (r < 88)
+        read_length = 16 + test_random() % 64;
+    else if (r < 97)
+        read_length = 0, write_length = 1 + test_random() % 16;
+    else
+        read_length = 80 + test_random() % 48;
+    snprintf(p_buf, size, "3;2;%u;%u;tag;Z", read_length, write_length);
+    return BUS_SCHEDULE_GUARD_US + (read_length + write_length) * BUS_SCHEDULE_BYTE_US;
+}
+
+/******************************************************************************
+* Function Name: test_stat
+* Description  : Reads a member of the bus_schedule statistics event.
+* Arguments    : p_event –
+*                    the event.
+*                p_key -
+*                    member name.
+* Return Value : its value, or 0xffffffff if it is missing.
+******************************************************************************/
+static uint32_t test_stat(const char * p_event, const char * p_key) {
+    char key[32];
+    const char * p_value;
+
+    snprintf(key, sizeof(key), "\"%s\":", p_key);
+    p_value = strstr(p_event, key);
+    return p_value ? (uint32_t)strtoul(p_value + strlen(key), NULL, 10) : 0xffffffffUL;
+}
+
+/******************************************************************************
+* Function Name: test_scheduled
+* Description  : Runs commands through bus_schedule_command with idle time
+*                in between, and checks each against the statistics of its
+*                own statistics period.
+* Arguments    : commands –
+*                    commands to run.
+* Return Value : samples delayed by a command.
+******************************************************************************/
+static uint32_t test_scheduled(long commands) {
+    char command[64];
+    char reply[8];
+    char event[256];
+    uint32_t samples = 0;
+    uint32_t jitter_max = 0;
+    uint32_t overruns = 0;
+    uint32_t deferred = 0;
+
+    for (long i = 0; i < commands; i++) {
+        test_run_until(now + test_random() % 15000);
+        uint32_t need = test_command(command, sizeof(command));
+        uint64_t start = now;
+        uint32_t delayed_before = delayed - resumed;
+
+        called_at = now;
+        starved_at = now + TEST_STARVED_US;
+        bus_schedule_command(command, reply);
+        test_check(bus_schedule_stats(event, sizeof(event)) > 0, "statistics event fits");
+        uint32_t overrun = test_stat(event, "overruns");
+        uint32_t waited = test_stat(event, "deferred");
+        samples += test_stat(event, "samples");
+        if (test_stat(event, "jitter_max_us") > jitter_max)
+            jitter_max = test_stat(event, "jitter_max_us");
+        overruns += overrun;
+        deferred += waited;
+        if (!need)
+            continue;
+        test_check(delayed - resumed == delayed_before || overrun == 1,
+                   "a sample is only delayed by an overrun, or on resuming");
+        test_check(need > BUS_SCHEDULE_SAMPLE_US - TEST_SAMPLE_BUS_US || !overrun,
+                   "a command which fits the gap after a sample does not overrun");
+        test_check(waited == (called_at > start), "deferred counts the commands which waited");
+        test_check(test_stat(event, "wait_max_us") == called_at - start, "wait_max_us is the wait");
+        test_check(called_at - start <= 3 * BUS_SCHEDULE_SAMPLE_US + TEST_SAMPLE_BUS_US,
+                   "a command waits at most about three sample periods");
+    }
+    test_run_until(now + 2 * TEST_TICK_US);
+    test_check(bus_schedule_stats(event, sizeof(event)) > 0, "statistics event fits");
+    samples += test_stat(event, "samples");
+    test_check(samples == sim_samples, "samples counts the sample intervals");
+    test_check(jitter_max == sim_jitter_max, "jitter_max_us is the largest wake jitter");
+    printf("bus_schedule_test: %ld commands, %u samples, jitter max %u us, %u deferred, %u overruns, "
+           "%u resumed into a command\n", commands, samples, jitter_max, deferred, overruns, resumed);
+    return delayed;
+}
+
+/******************************************************************************
+* Function Name: test_unscheduled
+* Description  : Runs the same commands straight on the bus, for comparison.
+* Arguments    : commands –
+*                    commands to run.
+* Return Value : samples delayed by a command.
+******************************************************************************/
+static uint32_t test_unscheduled(long commands) {
+    char command[64];
+
+    delayed = 0;
+    resumed = 0;
+    for (long i = 0; i < commands; i++) {
+        test_run_until(now + test_random() % 15000);
+        test_command(command, sizeof(command));
+        test_transfer(command);
+    }
+    return delayed;
+}
+
+int main(int argc, char * argv[]) {
+    long commands = (argc > 1) ? strtol(argv[1], NULL, 10) : TEST_COMMANDS;
+    uint32_t scheduled;
+    uint32_t unscheduled;
+
+    bus_schedule_init();
+    test_check(p_flags != NULL, "scheduler creates its event flags");
+    test_next_wake(now);
+    scheduled = test_scheduled(commands);
+    random_state = 12345;
+    unscheduled = test_unscheduled(commands);
+    printf("bus_schedule_test: samples delayed by a command %u scheduled, %u unscheduled\n",
+           scheduled, unscheduled);
+    test_check(scheduled < unscheduled, "scheduling delays fewer samples");
+    printf("bus_schedule_test: %d checks, %d failures\n", checks, failures);
+    return failures ? 1 : 0;
+}
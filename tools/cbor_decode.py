@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+"""Decode CBOR telemetry events published by the kit.
+
+Events encoded with json_begin_cbor() arrive as {"cbor":"<base64>"}, either
+alone or inside a {"batch":[...]} payload. This script replaces every such
+envelope by the decoded object, mapping integer keys back to their names,
+and prints the result as JSON.
+
+Usage: cbor_decode.py [file]   (reads stdin without a file)
+"""
+
+import base64
+import json
+import struct
+import sys
+
+# must match cbor_keys in src/json_writer.c
+CBOR_KEYS = [
+    "x_max", "x_min", "x_avg",
+    "y_max", "y_min", "y_avg",
+    "z_max", "z_min", "z_avg",
+    "sample_cnt", "window_ms", "energy",
+    "impact_cnt", "impact_peak_g", "impact_peak_ms", "temp_c",
+    "x_zero_cross", "y_zero_cross", "z_zero_cross",
+    "mag_cnt", "mag_field_max", "mag_field_min", "mag_field_avg", "mag_heading", "motor_on",
+    "snapshot",
+]
+
+BREAK = object()
+
+
+class Decoder:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def byte(self):
+        value = self.data[self.pos]
+        self.pos += 1
+        return value
+
+    def argument(self, info):
+        if info < 24:
+            return info
+        size = {24: 1, 25: 2, 26: 4, 27: 8}.get(info)
+        if size is None:
+            raise ValueError("unsupported additional info %d" % info)
+        value = int.from_bytes(self.data[self.pos:self.pos + size], "big")
+        self.pos += size
+        return value
+
+    def item(self):
+        initial = self.byte()
+        major, info = initial >> 5, initial & 0x1f
+        if initial == 0xff:
+            return BREAK
+        if major == 0:
+            return self.argument(info)
+        if major == 1:
+            return -1 - self.argument(info)
+        if major == 3:
+            length = self.argument(info)
+            text = self.data[self.pos:self.pos + length].decode("utf-8")
+            self.pos += length
+            return text
+        if major == 4:
+            if info == 31:
+                items = []
+                while True:
+                    value = self.item()
+                    if value is BREAK:
+                        return items
+                    items.append(value)
+            return [self.item() for _ in range(self.argument(info))]
+        if major == 5:
+            result = {}
+            count = None if info == 31 else self.argument(info)
+            while count is None or len(result) < count:
+                key = self.item()
+                if key is BREAK:
+                    break
+                if isinstance(key, int) and 0 <= key < len(CBOR_KEYS):
+                    key = CBOR_KEYS[key]
+                result[str(key)] = self.item()
+            return result
+        if major == 7:
+            if info == 20:
+                return False
+            if info == 21:
+                return True
+            if info == 22:
+                return None
+            if info == 25:
+                value = struct.unpack(">e", self.data[self.pos:self.pos + 2])[0]
+                self.pos += 2
+                return value
+            if info == 26:
+                value = struct.unpack(">f", self.data[self.pos:self.pos + 4])[0]
+                self.pos += 4
+                return value
+            if info == 27:
+                value = struct.unpack(">d", self.data[self.pos:self.pos + 8])[0]
+                self.pos += 8
+                return value
+        raise ValueError("unsupported CBOR item 0x%02x" % initial)
+
+
+def expand(value):
+    if isinstance(value, dict):
+        if set(value) == {"cbor"}:
+            return Decoder(base64.b64decode(value["cbor"])).item()
+        return {key: expand(item) for key, item in value.items()}
+    if isinstance(value, list):
+        return [expand(item) for item in value]
+    return value
+
+
+def main():
+    source = open(sys.argv[1]) if len(sys.argv) > 1 else sys.stdin
+    for line in source:
+        line = line.strip()
+        if line:
+            print(json.dumps(expand(json.loads(line))))
+
+
+if __name__ == "__main__":
+    main()
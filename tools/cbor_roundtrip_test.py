@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+"""Round-trip test of the CBOR encoding of src/json_writer.c.
+
+Runs json_writer_test --pairs, which prints every test event as JSON text
+and then as a CBOR envelope, decodes the envelope with cbor_decode.py and
+checks that both give the same members in the same order. Floats may differ
+by the last decimal of the JSON text, since CBOR keeps the value in half or
+single precision while the text is rounded.
+
+Usage: cbor_roundtrip_test.py <json_writer_test> [events]
+"""
+
+import json
+import os
+import subprocess
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from cbor_decode import expand  # noqa: E402
+
+
+class Number(str):
+    """A JSON number kept as its text, so its decimals are known."""
+
+
+def step(text):
+    """Unit of the last digit of a JSON number."""
+    if "." not in text:
+        return 1.0
+    return 10.0 ** -len(text.split(".")[1])
+
+
+def compare(text, decoded, path, errors):
+    if isinstance(text, dict):
+        if not isinstance(decoded, dict) or list(text) != list(decoded):
+            errors.append("%s: keys %s, decoded %s" % (path, list(text), decoded))
+            return
+        for key in text:
+            compare(text[key], decoded[key], path + "." + key, errors)
+    elif isinstance(text, Number):
+        if isinstance(decoded, bool) or not isinstance(decoded, (int, float)):
+            errors.append("%s: %s, decoded %r" % (path, text, decoded))
+        elif "." not in text and isinstance(decoded, int):
+            if int(text) != decoded:
+                errors.append("%s: %s, decoded %r" % (path, text, decoded))
+        elif abs(float(text) - decoded) > step(text) + abs(decoded) * 2.0 ** -22:
+            errors.append("%s: %s, decoded %r" % (path, text, decoded))
+    elif text != decoded or type(text) is not type(decoded):
+        errors.append("%s: %r, decoded %r" % (path, text, decoded))
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit(__doc__)
+    command = [sys.argv[1], "--pairs"] + sys.argv[2:3]
+    lines = subprocess.run(command, check=True, stdout=subprocess.PIPE,
+                           universal_newlines=True).stdout.splitlines()
+    if not lines or len(lines) % 2:
+        sys.exit("cbor_roundtrip_test: expected JSON and CBOR line pairs")
+
+    errors = []
+    json_bytes = cbor_bytes = 0
+    for index, (json_line, cbor_line) in enumerate(zip(lines[0::2], lines[1::2])):
+        text = json.loads(json_line, parse_int=Number, parse_float=Number)
+        envelope = json.loads(cbor_line)
+        if list(envelope) != ["cbor"]:
+            errors.append("not a CBOR envelope: %s" % cbor_line)
+            continue
+        compare(text, expand(envelope), "event %d" % index, errors)
+        json_bytes += len(json_line)
+        cbor_bytes += len(cbor_line)
+
+    for error in errors[:20]:
+        print("FAIL " + error, file=sys.stderr)
+    pairs = len(lines) // 2
+    print("cbor_roundtrip_test: %d events, %d failures, %.1f bytes/event JSON, %.1f bytes/event CBOR"
+          % (pairs, len(errors), json_bytes / pairs, cbor_bytes / pairs))
+    sys.exit(1 if errors else 0)
+
+
+if __name__ == "__main__":
+    main()
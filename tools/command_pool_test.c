@@ -0,0 +1,327 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : command_pool_test.c
+ * Version      : 1.0
+ * Device(s)    : Linux host
+ * Tool-Chain   : GNU GCC
+ * OS           : none
+ * H/W Platform : host
+ * Description  : Host test of src/command_pool.c on the block pools of
+ *                tools/threadx_host. Checks that the pools hold a buffer
+ *                for every command g_cloud_driver_command_queue and its
+ *                holders can keep, that a command longer than the large
+ *                class is refused, and then stresses the pools with a
+ *                random mix of command sizes, queued and completed in the
+ *                firmware's order. Fixed blocks cannot fragment: every
+ *                allocation must succeed exactly when some class that fits
+ *                has a free buffer, however long the run, and no buffer
+ *                may overlap another one in use.
+ *                Build and run (or use tools/host_tests.sh):
+ *                    cc -std=gnu99 -O2 -Itools/threadx_host -Isrc
+ *                       src/command_pool.c src/json_writer.c
+ *                       tools/threadx_host/tx_block_pool.c
+ *                       tools/command_pool_test.c -o command_pool_test
+ *                    ./command_pool_test [operations]
+ ******************************************************************************/
+
+#include "command_pool.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_OPERATIONS     2000000L
+#define TEST_CLASSES        3
+// every command the queue and its holders can keep
+#define TEST_BUFFERS        (COMMAND_POOL_QUEUE_DEPTH + COMMAND_POOL_HELD)
+
+typedef struct test_command
+{
+    char *      p_buf;
+    size_t      size;
+    int         class;
+    uint32_t    id;
+} test_command_t;
+
+static const size_t class_size[TEST_CLASSES] =
+{
+    COMMAND_POOL_SMALL_SIZE, COMMAND_POOL_MEDIUM_SIZE, COMMAND_POOL_LARGE_SIZE,
+};
+static const uint32_t class_count[TEST_CLASSES] =
+{
+    COMMAND_POOL_SMALL_COUNT, COMMAND_POOL_MEDIUM_COUNT, COMMAND_POOL_LARGE_COUNT,
+};
+static const char * const class_name[TEST_CLASSES] = { "small", "medium", "large" };
+
+// the commands in flight, oldest first
+static test_command_t commands[TEST_BUFFERS];
+static int command_cnt = 0;
+// the pools as the test expects them
+static uint32_t class_free[TEST_CLASSES];
+static uint32_t class_allocs[TEST_CLASSES];
+static uint32_t expected_dropped = 0;
+static uint32_t random_state = 12345;
+static int checks = 0;
+static int failures = 0;
+
+/******************************************************************************
+* Function Name: test_check
+* Description  : Counts a check and reports it if it failed.
+* Arguments    : ok –
+*                    result of the check.
+*                what -
+*                    description printed on failure.
+******************************************************************************/
+static void test_check(bool ok, const char * what) {
+    checks++;
+    if (!ok) {
+        failures++;
+        fprintf(stderr, "FAIL %s\n", what);
+    }
+}
+
+/******************************************************************************
+* Function Name: test_random
+* Description  : xorshift32 pseudo-random numbers, the same on every run.
+* Return Value : next number.
+******************************************************************************/
+static uint32_t test_random(void) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+/******************************************************************************
+* Function Name: test_size
+* Description  : Draws the size of a command: mostly short single commands,
+*                some batches and now and then one as long as an MQTT
+*                payload can be.
+* Return Value : bytes needed, including the terminator.
+******************************************************************************/
+static size_t test_size(void) {
+    uint32_t r = test_random() % 100;
+
+    if (r < 85)
+        return 1 + test_random() % COMMAND_POOL_SMALL_SIZE;
+    if (r < 97)
+        return 1 + test_random() % COMMAND_POOL_MEDIUM_SIZE;
+    return 1 + test_random() % COMMAND_POOL_LARGE_SIZE;
+}
+
+/******************************************************************************
+* Function Name: test_expected_class
+* Description  : The class command_pool_alloc should take a buffer from.
+* Arguments    : size –
+*                    bytes needed.
+* Return Value : index of the class, or -1 if the command must be refused.
+******************************************************************************/
+static int test_expected_class(size_t size) {
+    for (int i = 0; i < TEST_CLASSES; i++) {
+        if (size <= class_size[i] && class_free[i] > 0)
+            return i;
+    }
+    return -1;
+}
+
+/******************************************************************************
+* Function Name: test_fill
+* Description  : Writes the pattern of a command over its whole buffer.
+* Arguments    : p_command –
+*                    command in flight.
+******************************************************************************/
+static void test_fill(const test_command_t * p_command) {
+    for (size_t i = 0; i < p_command->size; i++)
+        p_command->p_buf[i] = (char)(p_command->id * 7 + i);
+}
+
+/******************************************************************************
+* Function Name: test_intact
+* Description  : Checks the pattern of a command, which another buffer
+*                overlapping it would have overwritten.
+* Arguments    : p_command –
+*                    command in flight.
+* Return Value : true if the pattern is unchanged.
+******************************************************************************/
+static bool test_intact(const test_command_t * p_command) {
+    for (size_t i = 0; i < p_command->size; i++) {
+        if (p_command->p_buf[i] != (char)(p_command->id * 7 + i))
+            return false;
+    }
+    return true;
+}
+
+/******************************************************************************
+* Function Name: test_queue
+* Description  : Allocates a command as m1_message_callback does, and checks
+*                the result against the expected pools.
+* Arguments    : size –
+*                    bytes needed.
+*                id -
+*                    number of the command.
+* Return Value : true if the command got a buffer.
+******************************************************************************/
+static bool test_queue(size_t size, uint32_t id) {
+    int class = test_expected_class(size);
+    char * p_buf = command_pool_alloc(size);
+
+    if (class < 0) {
+        expected_dropped++;
+        test_check(p_buf == NULL, "allocation without a free class refused");
+        return false;
+    }
+    test_check(p_buf != NULL, "allocation with a free class succeeds");
+    if (p_buf == NULL)
+        return false;
+    class_free[class]--;
+    class_allocs[class]++;
+    commands[command_cnt] = (test_command_t) { .p_buf = p_buf, .size = size, .class = class, .id = id };
+    test_fill(&commands[command_cnt]);
+    command_cnt++;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: test_complete
+* Description  : Completes a command in flight and frees its buffer.
+* Arguments    : index –
+*                    index of the command in commands[].
+******************************************************************************/
+static void test_complete(int index) {
+    test_command_t * p_command = &commands[index];
+
+    test_check(test_intact(p_command), "buffer not overwritten while in flight");
+    command_pool_free(p_command->p_buf);
+    class_free[p_command->class]++;
+    memmove(p_command, p_command + 1, (size_t)(command_cnt - index - 1) * sizeof(test_command_t));
+    command_cnt--;
+}
+
+/******************************************************************************
+* Function Name: test_drain
+* Description  : Completes every command in flight.
+******************************************************************************/
+static void test_drain(void) {
+    while (command_cnt > 0)
+        test_complete(0);
+}
+
+/******************************************************************************
+* Function Name: test_stats
+* Description  : Checks the statistics event against the expected pools and
+*                starts a new statistics period on both sides.
+******************************************************************************/
+static void test_stats(void) {
+    char event[256];
+    char key[32];
+    const char * p_class;
+    unsigned int allocs;
+    unsigned int count;
+    unsigned int dropped;
+
+    test_check(command_pool_stats(event, sizeof(event)) > 0, "statistics event fits");
+    for (int i = 0; i < TEST_CLASSES; i++) {
+        snprintf(key, sizeof(key), "\"%s\":", class_name[i]);
+        p_class = strstr(event, key);
+        test_check(p_class != NULL && sscanf(p_class + strlen(key), "{\"allocs\":%u", &allocs) == 1 &&
+                   allocs == class_allocs[i], "statistics allocations per class");
+        p_class = (p_class != NULL) ? strstr(p_class, "\"count\":") : NULL;
+        test_check(p_class != NULL && sscanf(p_class, "\"count\":%u", &count) == 1 && count == class_count[i],
+                   "statistics buffers per class");
+        class_allocs[i] = 0;
+    }
+    p_class = strstr(event, "\"dropped\":");
+    test_check(p_class != NULL && sscanf(p_class, "\"dropped\":%u", &dropped) == 1 && dropped == expected_dropped,
+               "statistics dropped commands");
+    expected_dropped = 0;
+}
+
+/******************************************************************************
+* Function Name: test_capacity
+* Description  : A buffer for every command the queue and its holders can
+*                keep, as long as they are short; then nothing more, and
+*                nothing longer than an MQTT payload at any time.
+******************************************************************************/
+static void test_capacity(void) {
+    int queued = 0;
+
+    test_check(COMMAND_POOL_SMALL_COUNT + COMMAND_POOL_MEDIUM_COUNT + COMMAND_POOL_LARGE_COUNT == TEST_BUFFERS,
+               "pools sized to the queue depth");
+    test_check(!test_queue(COMMAND_POOL_LARGE_SIZE + 1, 0), "command longer than the large class refused");
+    while (queued < TEST_BUFFERS && test_queue(1 + queued % 60, (uint32_t)queued))
+        queued++;
+    test_check(queued == TEST_BUFFERS, "short commands fill the queue");
+    test_check(!test_queue(1, 0), "full pools refuse a command");
+    test_drain();
+    for (int i = 0; i < COMMAND_POOL_LARGE_COUNT; i++)
+        test_check(test_queue(COMMAND_POOL_LARGE_SIZE, (uint32_t)i), "largest MQTT payload fits");
+    test_drain();
+    test_stats();
+}
+
+/******************************************************************************
+* Function Name: test_stress
+* Description  : Queues commands of random sizes and completes them mostly
+*                in order, as the sensor thread does, sometimes out of
+*                order, as the I2C worker does. The queue fills and drains
+*                in waves so the pools run empty again and again. Every
+*                check of test_queue holds on every allocation, and a
+*                short command always finds a buffer while the queue has
+*                room.
+* Arguments    : operations –
+*                    allocations and releases to run.
+******************************************************************************/
+static void test_stress(long operations) {
+    uint32_t id = 0;
+    int target = TEST_BUFFERS / 2;
+
+    for (long op = 0; op < operations; op++) {
+        if ((op & 1023) == 0)
+            target = (int)(test_random() % (TEST_BUFFERS + 8));
+        if (command_cnt < target || command_cnt == 0) {
+            size_t size = test_size();
+            bool room = command_cnt < TEST_BUFFERS;
+            bool queued = test_queue(size, id++);
+
+            test_check(queued || !room || size > COMMAND_POOL_SMALL_SIZE,
+                       "short command finds a buffer while the queue has room");
+        } else {
+            test_complete((test_random() % 8) ? 0 : (int)(test_random() % (uint32_t)command_cnt));
+        }
+        if ((op & 0xfffff) == 0xfffff)
+            test_stats();
+    }
+    test_drain();
+    test_stats();
+}
+
+int main(int argc, char * argv[]) {
+    long operations = (argc > 1) ? strtol(argv[1], NULL, 10) : TEST_OPERATIONS;
+
+    command_pool_init();
+    for (int i = 0; i < TEST_CLASSES; i++)
+        class_free[i] = class_count[i];
+    test_capacity();
+    test_stress(operations);
+    // after the stress, the pools are as good as new
+    test_capacity();
+    printf("command_pool_test: %ld operations, %d checks, %d failures\n", operations, checks, failures);
+    return failures ? 1 : 0;
+}
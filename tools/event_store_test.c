@@ -0,0 +1,362 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : event_store_test.c
+ * Version      : 1.0
+ * Device(s)    : Linux host
+ * Tool-Chain   : GNU GCC
+ * OS           : none
+ * H/W Platform : host
+ * Description  : Host test of src/event_store.c on the file-backed flash of
+ *                tools/store_flash_file.c. Checks that appended events come
+ *                back in order across a clean reopen, that a full ring keeps
+ *                the newest events, and that a power cut at any program or
+ *                erase loses nothing but the operation it cut. For the cuts
+ *                a child process appends and sends events until
+ *                store_flash_file_cut kills it part way through a flash
+ *                operation. The parent then reopens the file and drains
+ *                the store, so recovery only sees what reached the flash.
+ *                Build and run (or use tools/host_tests.sh):
+ *                    cc -std=gnu99 -O2 -Isrc -Itools src/event_store.c
+ *                       tools/store_flash_file.c tools/event_store_test.c
+ *                       -o event_store_test
+ *                    ./event_store_test [scratch file]
+ ******************************************************************************/
+
+#include "event_store.h"
+#include "store_flash_file.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// a region of a few sectors, so the ring wraps quickly
+#define TEST_SECTORS        4
+#define TEST_REGION_SIZE    (TEST_SECTORS * 4096)
+#define TEST_EVENT_MAX      128
+// marks the event appended after recovery
+#define TEST_EVENT_AFTER    999999
+
+// progress of the child, shared with the parent so it survives the cut
+typedef struct test_progress
+{
+    uint32_t    appended;   ///< events whose append returned.
+    uint32_t    next;       ///< first event not yet sent.
+    bool        appending;  ///< an append was under way, which may recycle a sector.
+    bool        popping;    ///< a pop was under way.
+    bool        dropped;    ///< the full ring dropped events.
+    bool        done;       ///< the scenario ended before the cut.
+} test_progress_t;
+
+static const char * p_path = "event_store_test.bin";
+static int checks = 0;
+static int failures = 0;
+
+/******************************************************************************
+* Function Name: test_check
+* Description  : Counts a check and reports it if it failed.
+* Arguments    : ok –
+*                    result of the check.
+*                what -
+*                    description printed on failure.
+******************************************************************************/
+static void test_check(bool ok, const char * what) {
+    checks++;
+    if (!ok) {
+        failures++;
+        fprintf(stderr, "FAIL %s\n", what);
+    }
+}
+
+/******************************************************************************
+* Function Name: test_event
+* Description  : Builds the payload of an event: its number, then a pattern
+*                up to a length which varies with the number.
+* Arguments    : id –
+*                    event number.
+*                p_buf -
+*                    buffer of TEST_EVENT_MAX bytes.
+* Return Value : payload length.
+******************************************************************************/
+static uint16_t test_event(uint32_t id, char * p_buf) {
+    uint16_t length = (uint16_t)(12 + id % 100);
+    int n = snprintf(p_buf, TEST_EVENT_MAX, "event %u;", id);
+
+    for (uint16_t i = (uint16_t)n; i < length; i++)
+        p_buf[i] = (char)('a' + (id + i) % 26);
+    return length;
+}
+
+/******************************************************************************
+* Function Name: test_event_id
+* Description  : Checks a payload and returns its event number.
+* Arguments    : p_buf –
+*                    payload.
+*                length -
+*                    payload length.
+* Return Value : event number, or -1 if the payload is not a test event.
+******************************************************************************/
+static long test_event_id(const char * p_buf, int length) {
+    char expect[TEST_EVENT_MAX];
+    unsigned int id;
+
+    if (length <= 0 || sscanf(p_buf, "event %u;", &id) != 1)
+        return -1;
+    if (test_event(id, expect) != length || memcmp(p_buf, expect, (size_t)length))
+        return -1;
+    return (long)id;
+}
+
+/******************************************************************************
+* Function Name: test_open
+* Description  : Opens the scratch file, as at boot, and recovers the store.
+* Arguments    : fresh –
+*                    start from an erased file.
+* Return Value : true if the store is usable.
+******************************************************************************/
+static bool test_open(bool fresh) {
+    if (fresh) {
+        store_flash_file_close();
+        remove(p_path);
+    }
+    const store_flash_t * p_flash = store_flash_file_open(p_path, TEST_REGION_SIZE);
+    return p_flash != NULL && event_store_init(p_flash) == 0;
+}
+
+/******************************************************************************
+* Function Name: test_append
+* Description  : Appends a test event.
+* Arguments    : id –
+*                    event number.
+* Return Value : result of event_store_append.
+******************************************************************************/
+static int test_append(uint32_t id) {
+    char buf[TEST_EVENT_MAX];
+    uint16_t length = test_event(id, buf);
+
+    return event_store_append(buf, length);
+}
+
+/******************************************************************************
+* Function Name: test_drain
+* Description  : Sends every pending event.
+* Arguments    : p_ids –
+*                    receives the event numbers, -1 for a bad payload.
+*                max -
+*                    size of p_ids.
+* Return Value : number of events sent.
+******************************************************************************/
+static int test_drain(long * p_ids, int max) {
+    char buf[TEST_EVENT_MAX];
+    int count = 0;
+    int length;
+
+    while (count < max && (length = event_store_peek(buf, sizeof(buf))) > 0) {
+        p_ids[count++] = test_event_id(buf, length);
+        event_store_pop();
+    }
+    return count;
+}
+
+/******************************************************************************
+* Function Name: test_contiguous
+* Description  : Checks that events were sent in order without gaps.
+* Arguments    : p_ids –
+*                    event numbers.
+*                count -
+*                    number of events.
+* Return Value : true if each event follows the one before.
+******************************************************************************/
+static bool test_contiguous(const long * p_ids, int count) {
+    for (int i = 0; i < count; i++) {
+        if (p_ids[i] < 0 || (i && p_ids[i] != p_ids[i - 1] + 1))
+            return false;
+    }
+    return true;
+}
+
+/******************************************************************************
+* Function Name: test_reopen
+* Description  : Appends, sends part of the events, and reopens the store in
+*                between, which must keep the unsent events and their order.
+******************************************************************************/
+static void test_reopen(void) {
+    long ids[200];
+    char buf[TEST_EVENT_MAX];
+    int count;
+
+    test_check(test_open(true) && event_store_pending() == 0, "reopen: fresh store is empty");
+    for (uint32_t id = 0; id < 100; id++)
+        test_check(test_append(id) == 0, "reopen: append");
+    test_check(test_open(false) && event_store_pending() == 100, "reopen: 100 pending after reopen");
+    count = test_drain(ids, 40);
+    test_check(count == 40 && test_contiguous(ids, count) && ids[0] == 0, "reopen: first 40 in order");
+    test_check(test_open(false) && event_store_pending() == 60, "reopen: 60 pending after second reopen");
+    test_check(test_event_id(buf, event_store_peek(buf, sizeof(buf))) == 40, "reopen: resumes at event 40");
+    test_check(test_append(100) == 0, "reopen: append after reopen");
+    count = test_drain(ids, 200);
+    test_check(count == 61 && test_contiguous(ids, count) && ids[0] == 40 && ids[60] == 100,
+               "reopen: remaining events and the new one in order");
+    test_check(test_open(false) && event_store_pending() == 0 && event_store_peek(buf, sizeof(buf)) == 0,
+               "reopen: nothing pending once sent");
+}
+
+/******************************************************************************
+* Function Name: test_wrap
+* Description  : Overfills the ring, which must drop the oldest events and
+*                keep the newest ones, also across a reopen.
+******************************************************************************/
+static void test_wrap(void) {
+    long ids[600];
+    int count;
+
+    test_check(test_open(true), "wrap: open");
+    for (uint32_t id = 0; id < 600; id++)
+        test_check(test_append(id) == 0, "wrap: append");
+    uint32_t pending = event_store_pending();
+    test_check(event_store_dropped() > 0 && pending + event_store_dropped() == 600,
+               "wrap: every event is pending or dropped");
+    test_check(pending > 100 && pending < 600, "wrap: ring keeps a few sectors of events");
+    test_check(test_open(false) && event_store_pending() == pending, "wrap: pending survives reopen");
+    count = test_drain(ids, 600);
+    test_check((uint32_t)count == pending && test_contiguous(ids, count) && ids[count - 1] == 599,
+               "wrap: newest events kept in order");
+}
+
+/******************************************************************************
+* Function Name: test_scenario
+* Description  : Child side of a cut: appends events and sends every
+*                pop_every-th, recording progress before each operation.
+* Arguments    : p_progress –
+*                    shared progress.
+*                events -
+*                    events to append.
+*                pop_every -
+*                    appends between sends.
+******************************************************************************/
+static void test_scenario(test_progress_t * p_progress, uint32_t events, uint32_t pop_every) {
+    char buf[TEST_EVENT_MAX];
+
+    for (uint32_t id = 0; id < events; id++) {
+        p_progress->appending = true;
+        if (test_append(id) == 0)
+            p_progress->appended = id + 1;
+        p_progress->appending = false;
+        p_progress->dropped = event_store_dropped() > 0;
+        if (id % pop_every == pop_every - 1) {
+            long sent = test_event_id(buf, event_store_peek(buf, sizeof(buf)));
+            p_progress->dropped = event_store_dropped() > 0;
+            if (sent < 0)
+                continue;
+            p_progress->next = (uint32_t)sent;
+            p_progress->popping = true;
+            event_store_pop();
+            p_progress->popping = false;
+            p_progress->next = (uint32_t)sent + 1;
+        }
+    }
+    p_progress->done = true;
+}
+
+/******************************************************************************
+* Function Name: test_cut
+* Description  : Cuts the power at one operation of a scenario and checks
+*                what the store recovers.
+* Arguments    : cut –
+*                    program or erase at which the child is killed.
+*                events -
+*                    events the scenario appends.
+*                pop_every -
+*                    appends between sends.
+*                p_progress -
+*                    shared progress.
+* Return Value : true if the scenario was cut before it ended.
+******************************************************************************/
+static bool test_cut(uint32_t cut, uint32_t events, uint32_t pop_every, test_progress_t * p_progress) {
+    long ids[1000];
+    char what[128];
+    int status;
+
+    memset(p_progress, 0, sizeof(*p_progress));
+    store_flash_file_close();
+    remove(p_path);
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (!test_open(true))
+            _exit(2);
+        store_flash_file_cut(cut);
+        test_scenario(p_progress, events, pop_every);
+        _exit(0);
+    }
+    if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status)) {
+        snprintf(what, sizeof(what), "cut %u: child failed", cut);
+        test_check(false, what);
+        return false;
+    }
+
+    // what a reset finds: the flash as the cut left it
+    snprintf(what, sizeof(what), "cut %u: recovery after %u appended, next %u", cut, p_progress->appended,
+             p_progress->next);
+    test_check(test_open(false), what);
+    test_check(test_append(TEST_EVENT_AFTER) == 0, what);
+    int count = test_drain(ids, 1000);
+    test_check(count > 0 && ids[count - 1] == TEST_EVENT_AFTER, what);
+    count--;
+    test_check(test_contiguous(ids, count), what);
+    if (count > 0) {
+        // nothing appended is lost and nothing sent comes back, unless the ring was
+        // full; the append that was cut may have completed
+        test_check(ids[count - 1] == (long)p_progress->appended - 1 ||
+                   (p_progress->appending && ids[count - 1] == (long)p_progress->appended), what);
+        test_check(ids[0] >= (long)p_progress->next, what);
+        test_check(p_progress->dropped || p_progress->appending ||
+                   ids[0] <= (long)p_progress->next + p_progress->popping, what);
+    } else {
+        test_check(p_progress->next + p_progress->popping >= p_progress->appended, what);
+    }
+    test_check(test_open(false) && event_store_pending() == 0, what);
+    return !p_progress->done;
+}
+
+int main(int argc, char * argv[]) {
+    test_progress_t * p_progress = mmap(NULL, sizeof(test_progress_t), PROT_READ | PROT_WRITE,
+                                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    uint32_t cuts = 0;
+
+    if (argc > 1)
+        p_path = argv[1];
+    if (p_progress == MAP_FAILED)
+        return 2;
+    test_reopen();
+    test_wrap();
+    // within the first sectors, at every operation
+    for (uint32_t cut = 1; test_cut(cut, 60, 3, p_progress); cut++)
+        cuts++;
+    // while the ring wraps and recycles sectors
+    for (uint32_t cut = 1; test_cut(cut, 600, 4, p_progress); cut += 3)
+        cuts++;
+    store_flash_file_close();
+    remove(p_path);
+    printf("event_store_test: %u power cuts, %d checks, %d failures\n", cuts, checks, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,26 @@
+#!/bin/sh
+# Builds and runs the host tests of the firmware modules in tools/.
+# tools/threadx_host stands in for ThreadX, SSP and app.h, so it goes before src.
+# Usage: tools/host_tests.sh [build directory]   (from the repository root)
+set -e
+
+CC=${CC:-cc}
+CFLAGS="-std=gnu99 -O2 -Wall -Wextra"
+INCLUDES="-Isrc -Itools"
+OUT=${1:-_host_build}
+mkdir -p "$OUT"
+
+$CC $CFLAGS $INCLUDES src/json_writer.c tools/json_writer_test.c -lm -o "$OUT/json_writer_test"
+"$OUT/json_writer_test" 20000
+python3 tools/cbor_roundtrip_test.py "$OUT/json_writer_test"
+
+$CC $CFLAGS $INCLUDES src/event_store.c tools/store_flash_file.c tools/event_store_test.c -o "$OUT/event_store_test"
+"$OUT/event_store_test" "$OUT/event_store_test.bin"
+
+$CC $CFLAGS -Itools/threadx_host $INCLUDES src/command_pool.c src/json_writer.c tools/threadx_host/tx_block_pool.c \
+    tools/command_pool_test.c -o "$OUT/command_pool_test"
+"$OUT/command_pool_test"
+
+$CC $CFLAGS -DI2C_VIBRATION -DUSE_SHARED_BUS -Itools/threadx_host $INCLUDES -Im1 src/bus_schedule.c src/json_writer.c \
+    tools/bus_schedule_test.c -o "$OUT/bus_schedule_test"
+"$OUT/bus_schedule_test"
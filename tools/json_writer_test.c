@@ -0,0 +1,614 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : json_writer_test.c
+ * Version      : 1.0
+ * Device(s)    : Linux host
+ * Tool-Chain   : GNU GCC
+ * OS           : none
+ * H/W Platform : host
+ * Description  : Host test of src/json_writer.c against the sprintf path it
+ *                replaced. Builds the same vibration window events both
+ *                ways, from pseudo-random windows and edge values, and
+ *                checks that the writer output has the same members in the
+ *                same order, with every number equal to the sprintf one
+ *                within the last decimal the writer keeps. Then times both
+ *                paths and the CBOR encoding, and prints the cost and size
+ *                per event.
+ *                With --pairs, prints each test event as JSON and as CBOR
+ *                on consecutive lines instead, which
+ *                tools/cbor_roundtrip_test.py decodes and compares.
+ *                Build and run (or use tools/host_tests.sh):
+ *                    cc -std=gnu99 -O2 -Isrc src/json_writer.c
+ *                       tools/json_writer_test.c -lm -o json_writer_test
+ *                    ./json_writer_test [iterations]
+ *                    ./json_writer_test --pairs [events]
+ ******************************************************************************/
+
+#include "json_writer.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// windows compared for equivalence, and default benchmark iterations
+#define TEST_WINDOWS        10000
+#define TEST_ITERATIONS     200000
+// the eventbuf of the vibration thread
+#define TEST_EVENT_SIZE     768
+// {"cbor":""} around the base64 of a CBOR event
+#define TEST_ENVELOPE_SIZE  11
+#define TEST_MEMBERS_MAX    32
+
+// one vibration window, as the vibration thread has it when it closes
+typedef struct test_window
+{
+    float       x_max, x_min, x_avg;
+    float       y_max, y_min, y_avg;
+    float       z_max, z_min, z_avg;
+    uint32_t    sample_cnt;
+    int32_t     window_ms;
+    float       energy;
+    uint32_t    impact_cnt;
+    float       impact_peak_g;
+    int32_t     impact_peak_ms;
+    float       temp_c;
+    uint32_t    x_zero_cross, y_zero_cross, z_zero_cross;
+    uint32_t    mag_cnt;
+    float       mag_field_max, mag_field_min, mag_field_avg, mag_heading;
+    bool        motor_on;
+} test_window_t;
+
+// a member of a flat JSON object, its value as text
+typedef struct test_member
+{
+    char        key[24];
+    char        value[40];
+} test_member_t;
+
+static uint32_t seed = 12345;
+static int checks = 0;
+static int failures = 0;
+
+/******************************************************************************
+* Function Name: test_random
+* Description  : Linear congruential generator, so runs are repeatable.
+* Return Value : pseudo-random float in [-1, 1).
+******************************************************************************/
+static float test_random(void) {
+    seed = seed * 1103515245u + 12345u;
+    return (float)(seed >> 8) / (float)(1u << 23) - 1.0f;
+}
+
+/******************************************************************************
+* Function Name: test_check
+* Description  : Counts a check and reports it if it failed.
+* Arguments    : ok –
+*                    result of the check.
+*                what -
+*                    description printed on failure.
+******************************************************************************/
+static void test_check(bool ok, const char * what) {
+    checks++;
+    if (!ok) {
+        failures++;
+        fprintf(stderr, "FAIL %s\n", what);
+    }
+}
+
+/******************************************************************************
+* Function Name: test_window_make
+* Description  : Fills a window with plausible accelerometer values.
+* Arguments    : p_window –
+*                    window to fill.
+*                mag -
+*                    whether the magnetometer members are present.
+******************************************************************************/
+static void test_window_make(test_window_t * p_window, bool mag) {
+    p_window->x_max = 2.0f * test_random();
+    p_window->x_min = 2.0f * test_random();
+    p_window->x_avg = test_random();
+    p_window->y_max = 2.0f * test_random();
+    p_window->y_min = 2.0f * test_random();
+    p_window->y_avg = test_random();
+    p_window->z_max = 1.0f + test_random();
+    p_window->z_min = 1.0f + test_random();
+    p_window->z_avg = 1.0f + 0.1f * test_random();
+    p_window->sample_cnt = 600 + (seed >> 24);
+    p_window->window_ms = 6000 + (int32_t)(seed >> 20);
+    p_window->energy = 0.01f * fabsf(test_random());
+    p_window->impact_cnt = seed >> 29;
+    p_window->impact_peak_g = 8.0f * fabsf(test_random());
+    p_window->impact_peak_ms = (int32_t)(seed >> 19) - 4000;
+    p_window->temp_c = 25.0f + 20.0f * test_random();
+    p_window->x_zero_cross = seed >> 25;
+    p_window->y_zero_cross = seed >> 26;
+    p_window->z_zero_cross = seed >> 27;
+    p_window->mag_cnt = mag ? 60 : 0;
+    p_window->mag_field_max = 60.0f + 20.0f * test_random();
+    p_window->mag_field_min = 40.0f + 20.0f * test_random();
+    p_window->mag_field_avg = 50.0f + 10.0f * test_random();
+    p_window->mag_heading = 180.0f + 180.0f * test_random();
+    p_window->motor_on = test_random() > 0;
+}
+
+/******************************************************************************
+* Function Name: test_window_sprintf
+* Description  : Builds the window event as the vibration thread did before
+*                json_writer.
+* Arguments    : p_window –
+*                    window to write.
+*                p_buf -
+*                    output buffer of TEST_EVENT_SIZE bytes.
+* Return Value : length of the event.
+******************************************************************************/
+static int test_window_sprintf(const test_window_t * p_window, char * p_buf) {
+    int event_len = sprintf(p_buf, "{"
+            "\"x_max\":%f,"
+            "\"x_min\":%f,"
+            "\"x_avg\":%f,"
+            "\"y_max\":%f,"
+            "\"y_min\":%f,"
+            "\"y_avg\":%f,"
+            "\"z_max\":%f,"
+            "\"z_min\":%f,"
+            "\"z_avg\":%f,"
+            "\"sample_cnt\":%u,"
+            "\"window_ms\":%d,"
+            "\"energy\":%f,"
+            "\"impact_cnt\":%u,"
+            "\"impact_peak_g\":%f,"
+            "\"impact_peak_ms\":%d,"
+            "\"temp_c\":%f,"
+            "\"x_zero_cross\":%u,"
+            "\"y_zero_cross\":%u,"
+            "\"z_zero_cross\":%u"
+            ,
+            (double)p_window->x_max,
+            (double)p_window->x_min,
+            (double)p_window->x_avg,
+            (double)p_window->y_max,
+            (double)p_window->y_min,
+            (double)p_window->y_avg,
+            (double)p_window->z_max,
+            (double)p_window->z_min,
+            (double)p_window->z_avg,
+            p_window->sample_cnt,
+            p_window->window_ms,
+            (double)p_window->energy,
+            p_window->impact_cnt,
+            (double)p_window->impact_peak_g,
+            p_window->impact_peak_ms,
+            (double)p_window->temp_c,
+            p_window->x_zero_cross,
+            p_window->y_zero_cross,
+            p_window->z_zero_cross
+            );
+    if (p_window->mag_cnt) {
+        event_len += sprintf(&p_buf[event_len],
+                ",\"mag_cnt\":%u,"
+                "\"mag_field_max\":%f,"
+                "\"mag_field_min\":%f,"
+                "\"mag_field_avg\":%f,"
+                "\"mag_heading\":%f,"
+                "\"motor_on\":%s"
+                ,
+                p_window->mag_cnt,
+                (double)p_window->mag_field_max,
+                (double)p_window->mag_field_min,
+                (double)p_window->mag_field_avg,
+                (double)p_window->mag_heading,
+                p_window->motor_on ? "true" : "false"
+                );
+    }
+    event_len += sprintf(&p_buf[event_len], "}");
+    return event_len;
+}
+
+/******************************************************************************
+* Function Name: test_window_writer
+* Description  : Builds the window event as the vibration thread does now,
+*                with the decimals it uses for each member.
+* Arguments    : p_window –
+*                    window to write.
+*                p_buf -
+*                    output buffer.
+*                size -
+*                    size of p_buf.
+*                cbor -
+*                    encode CBOR instead of JSON text.
+* Return Value : length of the event, or -1 if it did not fit.
+******************************************************************************/
+static int test_window_writer(const test_window_t * p_window, char * p_buf, size_t size, bool cbor) {
+    json_writer_t writer;
+
+    if (cbor)
+        json_begin_cbor(&writer, p_buf, size);
+    else
+        json_begin(&writer, p_buf, size);
+    json_key_float(&writer, "x_max", p_window->x_max, 4);
+    json_key_float(&writer, "x_min", p_window->x_min, 4);
+    json_key_float(&writer, "x_avg", p_window->x_avg, 4);
+    json_key_float(&writer, "y_max", p_window->y_max, 4);
+    json_key_float(&writer, "y_min", p_window->y_min, 4);
+    json_key_float(&writer, "y_avg", p_window->y_avg, 4);
+    json_key_float(&writer, "z_max", p_window->z_max, 4);
+    json_key_float(&writer, "z_min", p_window->z_min, 4);
+    json_key_float(&writer, "z_avg", p_window->z_avg, 4);
+    json_key_uint(&writer, "sample_cnt", p_window->sample_cnt);
+    json_key_int(&writer, "window_ms", p_window->window_ms);
+    json_key_float(&writer, "energy", p_window->energy, 6);
+    json_key_uint(&writer, "impact_cnt", p_window->impact_cnt);
+    json_key_float(&writer, "impact_peak_g", p_window->impact_peak_g, 4);
+    json_key_int(&writer, "impact_peak_ms", p_window->impact_peak_ms);
+    json_key_float(&writer, "temp_c", p_window->temp_c, 1);
+    json_key_uint(&writer, "x_zero_cross", p_window->x_zero_cross);
+    json_key_uint(&writer, "y_zero_cross", p_window->y_zero_cross);
+    json_key_uint(&writer, "z_zero_cross", p_window->z_zero_cross);
+    if (p_window->mag_cnt) {
+        json_key_uint(&writer, "mag_cnt", p_window->mag_cnt);
+        json_key_float(&writer, "mag_field_max", p_window->mag_field_max, 2);
+        json_key_float(&writer, "mag_field_min", p_window->mag_field_min, 2);
+        json_key_float(&writer, "mag_field_avg", p_window->mag_field_avg, 2);
+        json_key_float(&writer, "mag_heading", p_window->mag_heading, 1);
+        json_key_bool(&writer, "motor_on", p_window->motor_on);
+    }
+    return json_end(&writer);
+}
+
+/******************************************************************************
+* Function Name: test_parse
+* Description  : Splits a flat JSON object into its members. Only what the
+*                window event uses is accepted: unescaped keys and number,
+*                boolean or null values.
+* Arguments    : p_json –
+*                    null-terminated JSON object.
+*                p_members -
+*                    receives up to TEST_MEMBERS_MAX members.
+* Return Value : number of members, or -1 if the text is not such an object.
+******************************************************************************/
+static int test_parse(const char * p_json, test_member_t * p_members) {
+    const char * p = p_json;
+    int count = 0;
+
+    if (*p++ != '{')
+        return -1;
+    if (*p == '}')
+        return (p[1] == '\0') ? 0 : -1;
+    while (count < TEST_MEMBERS_MAX) {
+        test_member_t * p_member = &p_members[count++];
+        size_t length;
+
+        if (*p++ != '"')
+            return -1;
+        length = strcspn(p, "\"");
+        if (p[length] != '"' || length >= sizeof(p_member->key))
+            return -1;
+        memcpy(p_member->key, p, length);
+        p_member->key[length] = '\0';
+        p += length + 1;
+        if (*p++ != ':')
+            return -1;
+        length = strcspn(p, ",}");
+        if (!p[length] || !length || length >= sizeof(p_member->value))
+            return -1;
+        memcpy(p_member->value, p, length);
+        p_member->value[length] = '\0';
+        p += length;
+        if (*p == '}')
+            return (p[1] == '\0') ? count : -1;
+        p++;
+    }
+    return -1;
+}
+
+/******************************************************************************
+* Function Name: test_value_equal
+* Description  : Compares a writer value with the sprintf one.
+* Arguments    : p_writer –
+*                    value written by json_writer.
+*                p_sprintf -
+*                    value written by sprintf.
+*                decimals -
+*                    decimals the writer must keep, -1 for an integer or
+*                    literal.
+* Return Value : true if both are the same literal, or the writer value has
+*                exactly decimals digits after the point and is the sprintf
+*                value rounded to them, give or take float rounding.
+******************************************************************************/
+static bool test_value_equal(const char * p_writer, const char * p_sprintf, int decimals) {
+    char * p_end;
+    const char * p_point = strchr(p_writer, '.');
+
+    if (decimals < 0)
+        return !strcmp(p_writer, p_sprintf);
+    if (decimals == 0 ? p_point != NULL : (p_point == NULL || strlen(p_point + 1) != (size_t)decimals))
+        return false;
+    double writer_value = strtod(p_writer, &p_end);
+    if (*p_end)
+        return false;
+    double sprintf_value = strtod(p_sprintf, &p_end);
+    if (*p_end)
+        return false;
+    // sprintf already rounded to 6 decimals, and the writer rounds in single
+    // precision, so allow for both
+    return fabs(writer_value - sprintf_value) <= 0.5 * pow(10.0, -decimals) + 0.5e-6 + fabs(sprintf_value) * 1e-6;
+}
+
+/******************************************************************************
+* Function Name: test_decimals
+* Description  : Decimals the vibration thread keeps for a window member.
+* Arguments    : key –
+*                    member name.
+* Return Value : decimals, or -1 for members which are not floats.
+******************************************************************************/
+static int test_decimals(const char * key) {
+    static const struct {
+        const char *    key;
+        int             decimals;
+    } members[] = {
+        {"x_max", 4}, {"x_min", 4}, {"x_avg", 4}, {"y_max", 4}, {"y_min", 4}, {"y_avg", 4},
+        {"z_max", 4}, {"z_min", 4}, {"z_avg", 4}, {"energy", 6}, {"impact_peak_g", 4}, {"temp_c", 1},
+        {"mag_field_max", 2}, {"mag_field_min", 2}, {"mag_field_avg", 2}, {"mag_heading", 1},
+    };
+
+    for (size_t i = 0; i < sizeof(members) / sizeof(members[0]); i++) {
+        if (!strcmp(key, members[i].key))
+            return members[i].decimals;
+    }
+    return -1;
+}
+
+/******************************************************************************
+* Function Name: test_window_equivalent
+* Description  : Builds a window both ways and compares them.
+* Arguments    : p_window –
+*                    window to write.
+******************************************************************************/
+static void test_window_equivalent(const test_window_t * p_window) {
+    static char sprintf_buf[TEST_EVENT_SIZE];
+    static char writer_buf[TEST_EVENT_SIZE];
+    test_member_t sprintf_members[TEST_MEMBERS_MAX];
+    test_member_t writer_members[TEST_MEMBERS_MAX];
+    char what[TEST_EVENT_SIZE * 2 + 64];
+
+    test_window_sprintf(p_window, sprintf_buf);
+    int length = test_window_writer(p_window, writer_buf, sizeof(writer_buf), false);
+    int sprintf_count = test_parse(sprintf_buf, sprintf_members);
+    int writer_count = test_parse(writer_buf, writer_members);
+
+    snprintf(what, sizeof(what), "window\n  sprintf %s\n  writer  %s", sprintf_buf, writer_buf);
+    test_check(length > 0 && (size_t)length == strlen(writer_buf), what);
+    test_check(sprintf_count > 0 && writer_count == sprintf_count, what);
+    for (int i = 0; i < writer_count && i < sprintf_count; i++) {
+        bool same = !strcmp(writer_members[i].key, sprintf_members[i].key) &&
+                    test_value_equal(writer_members[i].value, sprintf_members[i].value,
+                                     test_decimals(writer_members[i].key));
+        if (!same) {
+            snprintf(what, sizeof(what), "member %.23s: writer %.39s, sprintf %.23s:%.39s", writer_members[i].key,
+                     writer_members[i].value, sprintf_members[i].key, sprintf_members[i].value);
+        }
+        test_check(same, what);
+    }
+}
+
+/******************************************************************************
+* Function Name: test_floats
+* Description  : Checks json_key_float edge values against their exact
+*                value, and the values printf would write wrongly or not as
+*                JSON.
+******************************************************************************/
+static void test_floats(void) {
+    static const struct {
+        float   value;
+        int     decimals;
+        const char * p_expect;  ///< exact output, or NULL to compare with printf.
+    } cases[] = {
+        {0.0f, 4, NULL}, {1.0f, 0, NULL}, {-1.0f, 0, NULL}, {0.00005f, 4, NULL},
+        {-0.99999f, 4, NULL}, {123.456f, 2, NULL}, {-273.15f, 1, NULL}, {4000.0f, 6, NULL},
+        {0.000001f, 6, NULL}, {1e9f, 0, NULL}, {42.5f, 9, NULL},
+        // printf writes -0.0000 and nan or inf, which are not JSON numbers
+        {-0.00001f, 4, "0.0000"}, {NAN, 4, "null"}, {INFINITY, 2, "null"}, {-INFINITY, 2, "null"},
+        {1e10f, 0, "null"}, {5000.0f, 6, "null"},
+    };
+    char buf[64];
+    char expect[64];
+    char what[160];
+    json_writer_t writer;
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        json_begin(&writer, buf, sizeof(buf));
+        json_key_float(&writer, "v", cases[i].value, cases[i].decimals);
+        json_end(&writer);
+        if (cases[i].p_expect != NULL) {
+            snprintf(expect, sizeof(expect), "{\"v\":%s}", cases[i].p_expect);
+            snprintf(what, sizeof(what), "float %g/%d: %s, expected %s", (double)cases[i].value,
+                     cases[i].decimals, buf, expect);
+            test_check(!strcmp(buf, expect), what);
+        } else {
+            int decimals = (cases[i].decimals > 6) ? 6 : cases[i].decimals;
+            snprintf(expect, sizeof(expect), "%.9g", (double)cases[i].value);
+            snprintf(what, sizeof(what), "float %g/%d: %s, printf %s", (double)cases[i].value,
+                     cases[i].decimals, buf, expect);
+            buf[strlen(buf) - 1] = '\0';
+            test_check(!strncmp(buf, "{\"v\":", 5) && test_value_equal(&buf[5], expect, decimals), what);
+        }
+    }
+}
+
+/******************************************************************************
+* Function Name: test_overflow
+* Description  : Checks that an event which does not fit is reported, at
+*                every buffer size, and never written past the buffer.
+******************************************************************************/
+static void test_overflow(void) {
+    test_window_t window;
+    char full[TEST_EVENT_SIZE];
+    char buf[TEST_EVENT_SIZE + 1];
+    char what[64];
+
+    test_window_make(&window, true);
+    int length = test_window_writer(&window, full, sizeof(full), false);
+    for (int size = 0; size <= length + 1; size++) {
+        memset(buf, 0x5a, sizeof(buf));
+        int result = test_window_writer(&window, buf, (size_t)size, false);
+        snprintf(what, sizeof(what), "overflow at size %d: %d", size, result);
+        test_check((size > length) ? (result == length && !strcmp(buf, full)) : (result == -1), what);
+        test_check((unsigned char)buf[size] == 0x5a, what);
+    }
+}
+
+/******************************************************************************
+* Function Name: test_elapsed
+* Description  : Nanoseconds between two monotonic times.
+******************************************************************************/
+static double test_elapsed(const struct timespec * p_start, const struct timespec * p_end) {
+    return (double)(p_end->tv_sec - p_start->tv_sec) * 1e9 + (double)(p_end->tv_nsec - p_start->tv_nsec);
+}
+
+/******************************************************************************
+* Function Name: test_benchmark
+* Description  : Times the sprintf path and the writer on the same windows.
+* Arguments    : iterations –
+*                    events built by each path.
+******************************************************************************/
+static void test_benchmark(long iterations) {
+    static test_window_t windows[64];
+    static char buf[TEST_EVENT_SIZE];
+    struct timespec start, end;
+    volatile size_t sink = 0;
+    size_t bytes;
+
+    for (size_t i = 0; i < sizeof(windows) / sizeof(windows[0]); i++)
+        test_window_make(&windows[i], i & 1);
+
+    bytes = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long i = 0; i < iterations; i++)
+        bytes += (size_t)test_window_sprintf(&windows[i & 63], buf);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    sink += bytes;
+    printf("sprintf      %8.0f ns/event %6.1f bytes/event\n", test_elapsed(&start, &end) / (double)iterations,
+           (double)bytes / (double)iterations);
+
+    bytes = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long i = 0; i < iterations; i++)
+        bytes += (size_t)test_window_writer(&windows[i & 63], buf, sizeof(buf), false);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    sink += bytes;
+    printf("json_writer  %8.0f ns/event %6.1f bytes/event\n", test_elapsed(&start, &end) / (double)iterations,
+           (double)bytes / (double)iterations);
+
+    // the base64 envelope is what gets published, the CBOR is 3/4 of its body
+    bytes = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long i = 0; i < iterations; i++)
+        bytes += (size_t)test_window_writer(&windows[i & 63], buf, sizeof(buf), true);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    sink += bytes;
+    printf("cbor         %8.0f ns/event %6.1f bytes/event (%.1f bytes CBOR)\n",
+           test_elapsed(&start, &end) / (double)iterations, (double)bytes / (double)iterations,
+           ((double)bytes / (double)iterations - TEST_ENVELOPE_SIZE) * 3 / 4);
+    (void)sink;
+}
+
+/******************************************************************************
+* Function Name: test_misc_event
+* Description  : Builds an event with what window events do not use: keys
+*                outside cbor_keys, nested objects, strings and negative,
+*                large and non-finite numbers.
+* Arguments    : n –
+*                    selects the values.
+*                p_buf -
+*                    output buffer.
+*                size -
+*                    size of p_buf.
+*                cbor -
+*                    encode CBOR instead of JSON text.
+* Return Value : length of the event, or -1 if it did not fit.
+******************************************************************************/
+static int test_misc_event(int n, char * p_buf, size_t size, bool cbor) {
+    static const char * const strings[] = {"", "a", "quote \" and \\", "tab\tline\n", "4+0,4-1520"};
+    json_writer_t writer;
+
+    if (cbor)
+        json_begin_cbor(&writer, p_buf, size);
+    else
+        json_begin(&writer, p_buf, size);
+    json_key_int(&writer, "status", -n);
+    json_key_int(&writer, "low", INT32_MIN + n);
+    json_key_uint(&writer, "high", UINT32_MAX - (uint32_t)n);
+    json_key_object(&writer, "nested");
+    json_key_string(&writer, "text", strings[n % 5]);
+    json_key_float(&writer, "temp_c", -40.0f + 0.37f * (float)n, 1);
+    json_key_object(&writer, "empty");
+    json_end_object(&writer);
+    json_key_float(&writer, "tiny", 1e-5f * (float)n, 6);
+    json_key_float(&writer, "large", 1e6f + (float)n, 2);
+    json_end_object(&writer);
+    json_key_float(&writer, "nan", NAN, 3);
+    json_key_bool(&writer, "motor_on", n & 1);
+    return json_end(&writer);
+}
+
+/******************************************************************************
+* Function Name: test_pairs
+* Description  : Prints test events as JSON and CBOR line pairs.
+* Arguments    : events –
+*                    number of window events, followed by the other events.
+******************************************************************************/
+static void test_pairs(long events) {
+    static char json_buf[TEST_EVENT_SIZE];
+    static char cbor_buf[TEST_EVENT_SIZE];
+    test_window_t window;
+
+    for (long i = 0; i < events; i++) {
+        test_window_make(&window, i & 1);
+        if (test_window_writer(&window, json_buf, sizeof(json_buf), false) > 0 &&
+            test_window_writer(&window, cbor_buf, sizeof(cbor_buf), true) > 0)
+            printf("%s\n%s\n", json_buf, cbor_buf);
+    }
+    for (int n = 0; n < 100; n++) {
+        if (test_misc_event(n, json_buf, sizeof(json_buf), false) > 0 &&
+            test_misc_event(n, cbor_buf, sizeof(cbor_buf), true) > 0)
+            printf("%s\n%s\n", json_buf, cbor_buf);
+    }
+}
+
+int main(int argc, char * argv[]) {
+    test_window_t window;
+    long iterations = (argc > 1) ? strtol(argv[1], NULL, 10) : TEST_ITERATIONS;
+
+    if (argc > 1 && !strcmp(argv[1], "--pairs")) {
+        test_pairs((argc > 2) ? strtol(argv[2], NULL, 10) : TEST_WINDOWS);
+        return 0;
+    }
+    test_floats();
+    test_overflow();
+    for (int i = 0; i < TEST_WINDOWS; i++) {
+        test_window_make(&window, i & 1);
+        test_window_equivalent(&window);
+    }
+    printf("json_writer_test: %d checks, %d failures\n", checks, failures);
+    if (iterations > 0)
+        test_benchmark(iterations);
+    return failures ? 1 : 0;
+}
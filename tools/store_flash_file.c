@@ -0,0 +1,178 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : store_flash_file.c
+ * Version      : 1.0
+ * Device(s)    : Linux host
+ * Tool-Chain   : GNU GCC
+ * OS           : none
+ * H/W Platform : host
+ * Description  : File-backed stand-in for the QSPI store_flash operations,
+ *                for running src/event_store.c on a Linux host. The file
+ *                behaves like NOR flash: program can only clear bits and
+ *                erase sets a whole sector to 0xff.
+ *                Build together with the store, for example:
+ *                    cc -Isrc -Itools src/event_store.c
+ *                       tools/store_flash_file.c my_host_program.c
+ *                and attach it with
+ *                    event_store_init(store_flash_file_open("store.bin", 64 * 1024));
+ *                Reopening the same file after killing the program
+ *                simulates a reset; store_flash_file_cut kills it in the
+ *                middle of a flash operation, as a power cut would.
+ ******************************************************************************/
+
+#include "store_flash_file.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define FILE_SECTOR_SIZE    4096
+#define FILE_PAGE_SIZE      256
+
+static FILE * p_file = NULL;
+// operations left before the power cut, 0 for none
+static uint32_t cut_countdown = 0;
+
+/******************************************************************************
+* Function Name: file_cut
+* Description  : Counts a program or erase towards the power cut. On the
+*                operation that is cut only the first half of its bytes
+*                reach the file, then the process exits at once.
+* Arguments    : offset –
+*                    file offset of the operation.
+*                p_data -
+*                    bytes the operation writes.
+*                length -
+*                    number of bytes.
+******************************************************************************/
+static void file_cut(uint32_t offset, const uint8_t * p_data, uint32_t length) {
+    if (cut_countdown == 0 || --cut_countdown > 0)
+        return;
+    if (!fseek(p_file, (long)offset, SEEK_SET))
+        fwrite(p_data, 1, length / 2, p_file);
+    fflush(p_file);
+    _exit(0);
+}
+
+/******************************************************************************
+* Function Name: file_read
+* Description  : Reads length bytes at offset.
+* Return Value : 0 on success, -1 on a file error.
+******************************************************************************/
+static int file_read(uint32_t offset, void * p_dest, uint32_t length) {
+    if (fseek(p_file, (long)offset, SEEK_SET) || fread(p_dest, 1, length, p_file) != length)
+        return -1;
+    return 0;
+}
+
+/******************************************************************************
+* Function Name: file_program
+* Description  : Programs length bytes within one page, only clearing bits.
+* Return Value : 0 on success, -1 on a file error or a page crossing.
+******************************************************************************/
+static int file_program(uint32_t offset, const void * p_src, uint32_t length) {
+    uint8_t page[FILE_PAGE_SIZE];
+    const uint8_t * p = p_src;
+
+    if (length > FILE_PAGE_SIZE || offset / FILE_PAGE_SIZE != (offset + length - 1) / FILE_PAGE_SIZE)
+        return -1;
+    if (file_read(offset, page, length))
+        return -1;
+    for (uint32_t i = 0; i < length; i++)
+        page[i] &= p[i];
+    file_cut(offset, page, length);
+    if (fseek(p_file, (long)offset, SEEK_SET) || fwrite(page, 1, length, p_file) != length)
+        return -1;
+    return fflush(p_file) ? -1 : 0;
+}
+
+/******************************************************************************
+* Function Name: file_erase
+* Description  : Erases the sector starting at offset to all ones.
+* Return Value : 0 on success, -1 on a file error or an unaligned offset.
+******************************************************************************/
+static int file_erase(uint32_t offset) {
+    uint8_t sector[FILE_SECTOR_SIZE];
+
+    if (offset % FILE_SECTOR_SIZE)
+        return -1;
+    memset(sector, 0xff, sizeof(sector));
+    file_cut(offset, sector, sizeof(sector));
+    if (fseek(p_file, (long)offset, SEEK_SET) || fwrite(sector, 1, sizeof(sector), p_file) != sizeof(sector))
+        return -1;
+    return fflush(p_file) ? -1 : 0;
+}
+
+static store_flash_t store_flash_file =
+{
+    .sector_size = FILE_SECTOR_SIZE,
+    .page_size = FILE_PAGE_SIZE,
+    .read = file_read,
+    .program = file_program,
+    .erase = file_erase,
+};
+
+/******************************************************************************
+* Function Name: store_flash_file_open
+* Description  : Opens the backing file, or creates it erased. Only one file
+*                is open at a time.
+* Arguments    : path –
+*                    backing file.
+*                size -
+*                    bytes in the region, a multiple of the sector size.
+* Return Value : flash operations on the file, or NULL on failure.
+******************************************************************************/
+const store_flash_t * store_flash_file_open(const char * path, uint32_t size) {
+    store_flash_file_close();
+    p_file = fopen(path, "r+b");
+    if (p_file == NULL) {
+        p_file = fopen(path, "w+b");
+        if (p_file == NULL)
+            return NULL;
+        for (uint32_t offset = 0; offset < size; offset += FILE_SECTOR_SIZE) {
+            if (file_erase(offset)) {
+                store_flash_file_close();
+                return NULL;
+            }
+        }
+    }
+    store_flash_file.size = size;
+    return &store_flash_file;
+}
+
+/******************************************************************************
+* Function Name: store_flash_file_close
+* Description  : Closes the backing file, if one is open.
+******************************************************************************/
+void store_flash_file_close(void) {
+    if (p_file != NULL)
+        fclose(p_file);
+    p_file = NULL;
+}
+
+/******************************************************************************
+* Function Name: store_flash_file_cut
+* Description  : Arms a power cut: the process exits in the middle of the
+*                given program or erase from now on.
+* Arguments    : operations –
+*                    1 for the next operation, 0 to disarm.
+******************************************************************************/
+void store_flash_file_cut(uint32_t operations) {
+    cut_countdown = operations;
+}
@@ -0,0 +1,97 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : tx_api.h
+ * Version      : 1.0
+ * Device(s)    : Linux host
+ * Tool-Chain   : GNU GCC
+ * OS           : none
+ * H/W Platform : host
+ * Description  : The part of the ThreadX API which the host tests of the
+ *                firmware modules need, single threaded. Put this directory
+ *                before src on the include path. Block pools are in
+ *                tx_block_pool.c; a test which waits on mutexes or event
+ *                flags provides them itself, as waiting means moving its
+ *                simulated time.
+ ******************************************************************************/
+
+#ifndef TX_API_H_
+#define TX_API_H_
+
+#include <stdint.h>
+
+typedef unsigned long   ULONG;
+typedef unsigned int    UINT;
+typedef char            CHAR;
+typedef unsigned char   UCHAR;
+typedef void            VOID;
+
+#define TX_SUCCESS          0x00
+#define TX_PTR_ERROR        0x03
+#define TX_SIZE_ERROR       0x05
+#define TX_NO_EVENTS        0x07
+#define TX_NO_MEMORY        0x10
+#define TX_NO_WAIT          0
+#define TX_WAIT_FOREVER     0xFFFFFFFFUL
+#define TX_NULL             ((void *)0)
+#define TX_NO_INHERIT       0
+#define TX_OR               0
+#define TX_OR_CLEAR         1
+
+// a host test has no interrupts
+#define TX_INTERRUPT_SAVE_AREA
+#define TX_DISABLE
+#define TX_RESTORE
+
+typedef struct TX_THREAD_STRUCT TX_THREAD;
+
+// fixed-size blocks, each with a pointer to its pool in front, as ThreadX
+typedef struct TX_BLOCK_POOL_STRUCT
+{
+    CHAR *                          tx_block_pool_name;
+    ULONG                           tx_block_pool_available;
+    ULONG                           tx_block_pool_total;
+    UCHAR *                         tx_block_pool_available_list;
+    ULONG                           tx_block_pool_block_size;
+} TX_BLOCK_POOL;
+
+typedef struct TX_MUTEX_STRUCT
+{
+    UINT                            tx_mutex_ownership_count;
+} TX_MUTEX;
+
+typedef struct TX_EVENT_FLAGS_GROUP_STRUCT
+{
+    ULONG                           tx_event_flags_group_current;
+} TX_EVENT_FLAGS_GROUP;
+
+UINT tx_block_pool_create(TX_BLOCK_POOL * pool_ptr, CHAR * name_ptr, ULONG block_size, VOID * pool_start,
+                          ULONG pool_size);
+UINT tx_block_allocate(TX_BLOCK_POOL * pool_ptr, VOID ** block_ptr, ULONG wait_option);
+UINT tx_block_release(VOID * block_ptr);
+UINT tx_block_pool_info_get(TX_BLOCK_POOL * pool_ptr, CHAR ** name, ULONG * available_blocks, ULONG * total_blocks,
+                            TX_THREAD ** first_suspended, ULONG * suspended_count, TX_BLOCK_POOL ** next_pool);
+UINT tx_mutex_create(TX_MUTEX * mutex_ptr, CHAR * name_ptr, UINT inherit);
+UINT tx_mutex_get(TX_MUTEX * mutex_ptr, ULONG wait_option);
+UINT tx_mutex_put(TX_MUTEX * mutex_ptr);
+UINT tx_event_flags_create(TX_EVENT_FLAGS_GROUP * group_ptr, CHAR * name_ptr);
+UINT tx_event_flags_get(TX_EVENT_FLAGS_GROUP * group_ptr, ULONG requested_flags, UINT get_option,
+                        ULONG * actual_flags_ptr, ULONG wait_option);
+UINT tx_event_flags_set(TX_EVENT_FLAGS_GROUP * group_ptr, ULONG flags_to_set, UINT set_option);
+
+#endif /* TX_API_H_ */
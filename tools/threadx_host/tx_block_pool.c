@@ -0,0 +1,126 @@
+/***********************************************************************************************************************
+ * Copyright [2015] Renesas Electronics Corporation and/or its licensors. All Rights Reserved.
+ *
+ * The contents of this file (the "contents") are proprietary and confidential to Renesas Electronics Corporation
+ * and/or its licensors ("Renesas") and subject to statutory and contractual protections.
+ *
+ * Unless otherwise expressly agreed in writing between Renesas and you: 1) you may not use, copy, modify, distribute,
+ * display, or perform the contents; 2) you may not use any name or mark of Renesas for advertising or publicity
+ * purposes or in connection with your use of the contents; 3) RENESAS MAKES NO WARRANTY OR REPRESENTATIONS ABOUT THE
+ * SUITABILITY OF THE CONTENTS FOR ANY PURPOSE; THE CONTENTS ARE PROVIDED "AS IS" WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTY, INCLUDING THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, AND
+ * NON-INFRINGEMENT; AND 4) RENESAS SHALL NOT BE LIABLE FOR ANY DIRECT, INDIRECT, SPECIAL, OR CONSEQUENTIAL DAMAGES,
+ * INCLUDING DAMAGES RESULTING FROM LOSS OF USE, DATA, OR PROJECTS, WHETHER IN AN ACTION OF CONTRACT OR TORT, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THE CONTENTS. Third-party contents included in this file may
+ * be subject to different terms.
+ **********************************************************************************************************************/
+
+ /*******************************************************************************
+ * File Name    : tx_block_pool.c
+ * Version      : 1.0
+ * Device(s)    : Linux host
+ * Tool-Chain   : GNU GCC
+ * OS           : none
+ * H/W Platform : host
+ * Description  : Host block pools with the layout of ThreadX: the block size
+ *                is rounded up to a ULONG, every block has a pointer in front
+ *                which points to its pool while the block is allocated and
+ *                to the next free block while it is free, and a pool holds
+ *                as many blocks as fit its memory. A host test which sizes
+ *                the memory like the firmware thus gets the same count.
+ ******************************************************************************/
+
+#include "tx_api.h"
+
+#include <stddef.h>
+
+/******************************************************************************
+* Function Name: tx_block_pool_create
+* Description  : Divides the memory into blocks and links them as free.
+* Return Value : TX_SUCCESS, TX_PTR_ERROR or TX_SIZE_ERROR.
+******************************************************************************/
+UINT tx_block_pool_create(TX_BLOCK_POOL * pool_ptr, CHAR * name_ptr, ULONG block_size, VOID * pool_start,
+                          ULONG pool_size) {
+    ULONG step;
+    UCHAR * p_block = pool_start;
+    UCHAR * p_next = NULL;
+
+    if (pool_ptr == NULL || pool_start == NULL)
+        return TX_PTR_ERROR;
+    block_size = (block_size + sizeof(ULONG) - 1) / sizeof(ULONG) * sizeof(ULONG);
+    step = block_size + sizeof(UCHAR *);
+    pool_ptr->tx_block_pool_name = name_ptr;
+    pool_ptr->tx_block_pool_block_size = block_size;
+    pool_ptr->tx_block_pool_total = pool_size / step;
+    if (pool_ptr->tx_block_pool_total == 0)
+        return TX_SIZE_ERROR;
+    // link from the last block, so the first block is allocated first
+    for (ULONG i = pool_ptr->tx_block_pool_total; i-- > 0;) {
+        *(UCHAR **)(void *)(p_block + i * step) = p_next;
+        p_next = p_block + i * step;
+    }
+    pool_ptr->tx_block_pool_available_list = p_next;
+    pool_ptr->tx_block_pool_available = pool_ptr->tx_block_pool_total;
+    return TX_SUCCESS;
+}
+
+/******************************************************************************
+* Function Name: tx_block_allocate
+* Description  : Takes the first free block. There are no other threads to
+*                wait for, so the wait option is ignored.
+* Return Value : TX_SUCCESS, or TX_NO_MEMORY if the pool is empty.
+******************************************************************************/
+UINT tx_block_allocate(TX_BLOCK_POOL * pool_ptr, VOID ** block_ptr, ULONG wait_option) {
+    UCHAR * p_block = pool_ptr->tx_block_pool_available_list;
+
+    (void)wait_option;
+    if (p_block == NULL)
+        return TX_NO_MEMORY;
+    pool_ptr->tx_block_pool_available_list = *(UCHAR **)(void *)p_block;
+    pool_ptr->tx_block_pool_available--;
+    *(TX_BLOCK_POOL **)(void *)p_block = pool_ptr;
+    *block_ptr = p_block + sizeof(UCHAR *);
+    return TX_SUCCESS;
+}
+
+/******************************************************************************
+* Function Name: tx_block_release
+* Description  : Returns a block to the pool recorded in front of it.
+* Return Value : TX_SUCCESS, or TX_PTR_ERROR for a NULL block.
+******************************************************************************/
+UINT tx_block_release(VOID * block_ptr) {
+    UCHAR * p_block;
+    TX_BLOCK_POOL * pool_ptr;
+
+    if (block_ptr == NULL)
+        return TX_PTR_ERROR;
+    p_block = (UCHAR *)block_ptr - sizeof(UCHAR *);
+    pool_ptr = *(TX_BLOCK_POOL **)(void *)p_block;
+    *(UCHAR **)(void *)p_block = pool_ptr->tx_block_pool_available_list;
+    pool_ptr->tx_block_pool_available_list = p_block;
+    pool_ptr->tx_block_pool_available++;
+    return TX_SUCCESS;
+}
+
+/******************************************************************************
+* Function Name: tx_block_pool_info_get
+* Description  : Reports the name and block counts of a pool. Nothing is
+*                ever suspended on a host pool.
+* Return Value : TX_SUCCESS.
+******************************************************************************/
+UINT tx_block_pool_info_get(TX_BLOCK_POOL * pool_ptr, CHAR ** name, ULONG * available_blocks, ULONG * total_blocks,
+                            TX_THREAD ** first_suspended, ULONG * suspended_count, TX_BLOCK_POOL ** next_pool) {
+    if (name != NULL)
+        *name = pool_ptr->tx_block_pool_name;
+    if (available_blocks != NULL)
+        *available_blocks = pool_ptr->tx_block_pool_available;
+    if (total_blocks != NULL)
+        *total_blocks = pool_ptr->tx_block_pool_total;
+    if (first_suspended != NULL)
+        *first_suspended = NULL;
+    if (suspended_count != NULL)
+        *suspended_count = 0;
+    if (next_pool != NULL)
+        *next_pool = NULL;
+    return TX_SUCCESS;
+}